@@ -0,0 +1,293 @@
+#include "PlatformUtils/AppendLog.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace IOUtils
+{
+   AppendLog::AppendLog(const std::filesystem::path& path, const AppendLogOptions& logOptions)
+      : options(logOptions)
+   {
+      std::error_code errorCode;
+      std::filesystem::create_directories(path.parent_path(), errorCode);
+
+      if (std::optional<OSUtils::File> openedFile = OSUtils::openFile(path, OSUtils::FileOpenMode::Append))
+      {
+         file = std::move(*openedFile);
+         writerThread = std::thread([this]() { runWriter(); });
+      }
+      else
+      {
+         // Nothing can ever be written, so appends are dropped and waiting fails right away
+         closing = true;
+         writerStopped = true;
+         publishDurable(0, true);
+      }
+   }
+
+   AppendLog::~AppendLog()
+   {
+      close();
+   }
+
+   uint64_t AppendLog::append(std::span<const uint8_t> record)
+   {
+      // Taking a sequence number would leave a gap that the writer waits for forever
+      if (closing)
+      {
+         return kInvalidSequence;
+      }
+
+      Record* queuedRecord = allocateRecord(record.size());
+      if (!record.empty())
+      {
+         std::memcpy(queuedRecord->getData(), record.data(), record.size());
+      }
+
+      // The sequence number might be taken before a record that gets queued first, the writer puts them back in order
+      uint64_t sequence = nextSequence.fetch_add(1);
+      queuedRecord->sequence = sequence;
+
+      Record* head = queueHead.load(std::memory_order_relaxed);
+      do
+      {
+         queuedRecord->next = head;
+      } while (!queueHead.compare_exchange_weak(head, queuedRecord, std::memory_order_seq_cst, std::memory_order_relaxed));
+
+      // The record belongs to the writer once it's queued (and might already be gone)
+      wakeWriter();
+
+      return sequence;
+   }
+
+   uint64_t AppendLog::append(std::string_view record)
+   {
+      return append(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(record.data()), record.size()));
+   }
+
+   bool AppendLog::waitUntilDurable(uint64_t sequence)
+   {
+      auto isDone = [this, sequence]()
+      {
+         uint64_t state = durableState.load(std::memory_order_acquire);
+         return (state & ~kFailedFlag) > sequence || (state & kFailedFlag) != 0 || writerStopped;
+      };
+
+      if (!isDone())
+      {
+         std::unique_lock<std::mutex> lock(durableMutex);
+         durableCondition.wait(lock, isDone);
+      }
+
+      return (durableState.load(std::memory_order_acquire) & ~kFailedFlag) > sequence;
+   }
+
+   bool AppendLog::flush()
+   {
+      uint64_t numAppended = nextSequence.load();
+      if (numAppended == 0)
+      {
+         return (durableState.load() & kFailedFlag) == 0;
+      }
+
+      syncRequested = true;
+      wakeWriter();
+
+      return waitUntilDurable(numAppended - 1);
+   }
+
+   bool AppendLog::close()
+   {
+      closing = true;
+
+      if (writerThread.joinable())
+      {
+         wakeWriter();
+
+         writerThread.join();
+         file.close();
+      }
+
+      {
+         std::lock_guard<std::mutex> lock(durableMutex);
+         writerStopped = true;
+      }
+      durableCondition.notify_all();
+
+      // Records from appends that raced with closing were never seen by the writer
+      Record* record = queueHead.exchange(nullptr, std::memory_order_acquire);
+      while (record)
+      {
+         Record* next = record->next;
+         freeRecord(record);
+         record = next;
+      }
+
+      return (durableState.load() & kFailedFlag) == 0;
+   }
+
+   AppendLog::Record* AppendLog::allocateRecord(std::size_t size)
+   {
+      // The record's data directly follows it, so each record is a single allocation
+      void* memory = ::operator new(sizeof(Record) + size);
+
+      Record* record = new (memory) Record{};
+      record->size = size;
+
+      return record;
+   }
+
+   void AppendLog::freeRecord(Record* record)
+   {
+      record->~Record();
+      ::operator delete(record);
+   }
+
+   void AppendLog::runWriter()
+   {
+      std::vector<Record*> pendingRecords; // Taken from the queue, sorted by sequence number
+      std::vector<std::span<const uint8_t>> fragments;
+      uint64_t numWritten = 0;
+      uint64_t numSynced = 0;
+      bool writeFailed = false;
+      bool syncWanted = false; // Remembered until the records it was requested for have been written and synced
+      std::optional<std::chrono::steady_clock::time_point> syncDeadline;
+
+      while (true)
+      {
+         // Checked before taking the queue, so that everything appended before close() / flush() is still written
+         bool closingNow = closing;
+         syncWanted |= syncRequested.exchange(false);
+
+         Record* takenRecords = queueHead.exchange(nullptr, std::memory_order_acquire);
+         bool tookRecords = takenRecords != nullptr;
+         for (Record* record = takenRecords; record; record = record->next)
+         {
+            pendingRecords.push_back(record);
+         }
+
+         if (tookRecords)
+         {
+            std::sort(pendingRecords.begin(), pendingRecords.end(), [](const Record* first, const Record* second) { return first->sequence < second->sequence; });
+
+            // A gap means a producer has taken a sequence number but not queued its record yet, so only write up to there
+            std::size_t numReady = 0;
+            while (numReady < pendingRecords.size() && pendingRecords[numReady]->sequence == numWritten + numReady)
+            {
+               ++numReady;
+            }
+
+            if (numReady > 0)
+            {
+               std::span<Record* const> readyRecords(pendingRecords.data(), numReady);
+               if (!writeFailed && !writeRecords(readyRecords, fragments))
+               {
+                  writeFailed = true;
+                  publishDurable(numSynced, writeFailed);
+               }
+
+               for (Record* record : readyRecords)
+               {
+                  freeRecord(record);
+               }
+               pendingRecords.erase(pendingRecords.begin(), pendingRecords.begin() + numReady);
+               numWritten += numReady;
+
+               if (!options.sync)
+               {
+                  numSynced = numWritten;
+                  publishDurable(numSynced, writeFailed);
+               }
+               else if (!syncDeadline)
+               {
+                  syncDeadline = std::chrono::steady_clock::now() + options.maxSyncDelay;
+               }
+            }
+         }
+
+         // Everything written since the last sync is made durable by a single sync
+         bool unsynced = numSynced < numWritten && !writeFailed;
+         if (unsynced && (syncWanted || closingNow || std::chrono::steady_clock::now() >= *syncDeadline))
+         {
+            if (file.sync())
+            {
+               numSynced = numWritten;
+            }
+            else
+            {
+               writeFailed = true;
+            }
+
+            publishDurable(numSynced, writeFailed);
+            syncDeadline.reset();
+            unsynced = false;
+         }
+
+         if (!unsynced && pendingRecords.empty())
+         {
+            syncWanted = false;
+         }
+
+         if (closingNow && !tookRecords && pendingRecords.empty() && !unsynced)
+         {
+            break;
+         }
+
+         if (!tookRecords)
+         {
+            waitForWork(unsynced ? syncDeadline : std::nullopt);
+         }
+      }
+   }
+
+   bool AppendLog::writeRecords(std::span<Record* const> records, std::vector<std::span<const uint8_t>>& fragments)
+   {
+      fragments.clear();
+      for (Record* record : records)
+      {
+         fragments.emplace_back(record->getData(), record->size);
+      }
+
+      return file.write(fragments);
+   }
+
+   void AppendLog::publishDurable(uint64_t numDurable, bool writeFailed)
+   {
+      {
+         std::lock_guard<std::mutex> lock(durableMutex);
+         durableState.store(numDurable | (writeFailed ? kFailedFlag : 0), std::memory_order_release);
+      }
+
+      durableCondition.notify_all();
+   }
+
+   void AppendLog::waitForWork(std::optional<std::chrono::steady_clock::time_point> deadline)
+   {
+      std::unique_lock<std::mutex> lock(writerMutex);
+
+      // Producers check this after queueing, so either they see it and wake us up, or we see their record
+      writerSleeping = true;
+
+      auto hasWork = [this]() { return queueHead.load() != nullptr || closing || syncRequested; };
+      if (deadline)
+      {
+         writerCondition.wait_until(lock, *deadline, hasWork);
+      }
+      else
+      {
+         writerCondition.wait(lock, hasWork);
+      }
+
+      writerSleeping = false;
+   }
+
+   void AppendLog::wakeWriter()
+   {
+      if (writerSleeping)
+      {
+         std::lock_guard<std::mutex> lock(writerMutex);
+         writerCondition.notify_one();
+      }
+   }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "OSUtils.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace IOUtils
+{
+   struct AppendLogOptions
+   {
+      // Whether records are flushed all the way to the storage device (in groups), rather than just handed to the OS
+      bool sync = true;
+
+      // How long to keep gathering records into a group before syncing it
+      // Longer delays mean fewer syncs (more throughput), at the cost of each record taking longer to become durable
+      std::chrono::microseconds maxSyncDelay = std::chrono::microseconds(0);
+   };
+
+   // Append-only log that any number of threads can add records to concurrently
+   // Records are passed to a writer thread through a lock-free queue, then written in batches (a single gathering write each) and synced in groups
+   // Records are written exactly as given (add any separators yourself), in the order of their sequence numbers
+   class AppendLog
+   {
+   public:
+      static constexpr uint64_t kInvalidSequence = std::numeric_limits<uint64_t>::max();
+
+      explicit AppendLog(const std::filesystem::path& path, const AppendLogOptions& logOptions = {});
+      AppendLog(const AppendLog& other) = delete;
+      ~AppendLog();
+
+      AppendLog& operator=(const AppendLog& other) = delete;
+
+      bool isOpen() const
+      {
+         return writerThread.joinable();
+      }
+
+      // Queues a record (without blocking), returning its sequence number
+      // If the log isn't open (it couldn't be, or it's been closed), the record is dropped and kInvalidSequence is returned, which waitUntilDurable() reports as failed
+      uint64_t append(std::span<const uint8_t> record);
+      uint64_t append(std::string_view record);
+
+      // Blocks until the record is durable (synced, or just written if syncing is disabled), returning false if writing failed
+      bool waitUntilDurable(uint64_t sequence);
+
+      // Syncs everything appended so far without waiting for the sync delay, blocking until it's durable
+      bool flush();
+
+      // Writes and syncs any remaining records, records appended afterwards are dropped
+      bool close();
+
+   private:
+      struct Record
+      {
+         Record* next = nullptr;
+         uint64_t sequence = 0;
+         std::size_t size = 0;
+
+         uint8_t* getData()
+         {
+            return reinterpret_cast<uint8_t*>(this + 1);
+         }
+      };
+
+      static Record* allocateRecord(std::size_t size);
+      static void freeRecord(Record* record);
+
+      static constexpr uint64_t kFailedFlag = uint64_t{ 1 } << 63;
+
+      void runWriter();
+      bool writeRecords(std::span<Record* const> records, std::vector<std::span<const uint8_t>>& fragments);
+      void publishDurable(uint64_t numDurable, bool writeFailed);
+      void waitForWork(std::optional<std::chrono::steady_clock::time_point> deadline);
+      void wakeWriter();
+
+      AppendLogOptions options;
+      OSUtils::File file;
+      std::thread writerThread;
+
+      // Producers push onto the front of an intrusive stack, the writer takes the whole stack at once and restores the order
+      std::atomic<Record*> queueHead = { nullptr };
+      std::atomic<uint64_t> nextSequence = { 0 };
+
+      std::atomic<uint64_t> durableState = { 0 }; // Every sequence number below this is durable, kFailedFlag is set once writing fails
+      std::mutex durableMutex; // Only taken by threads that actually have to wait
+      std::condition_variable durableCondition;
+      std::atomic<bool> writerStopped = { false }; // Nothing more will become durable, so waiting stops
+      std::atomic<bool> closing = { false };
+      std::atomic<bool> syncRequested = { false };
+
+      // Only used to put the writer to sleep when there's nothing to do, producers don't touch it unless the writer is asleep
+      std::mutex writerMutex;
+      std::condition_variable writerCondition;
+      std::atomic<bool> writerSleeping = { false };
+   };
+}
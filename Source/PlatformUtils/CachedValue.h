@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace OSUtils
+{
+   // Lazily computed value that can be read from any thread without locking once it has been computed
+   // Refreshing publishes a new value, but previous values are kept alive, so references handed out earlier never dangle (refreshes are expected to be rare)
+   template<typename T>
+   class CachedValue
+   {
+   public:
+      template<typename Function>
+      const T& get(Function&& compute)
+      {
+         if (const T* value = current.load(std::memory_order_acquire))
+         {
+            return *value;
+         }
+
+         std::lock_guard<std::mutex> lock(mutex);
+
+         // Another thread might have computed it while we were waiting for the lock
+         if (const T* value = current.load(std::memory_order_relaxed))
+         {
+            return *value;
+         }
+
+         return publish(compute());
+      }
+
+      // The next get() will compute the value again
+      void refresh()
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+
+         current.store(nullptr, std::memory_order_release);
+      }
+
+   private:
+      const T& publish(T value)
+      {
+         values.push_back(std::make_unique<const T>(std::move(value)));
+         current.store(values.back().get(), std::memory_order_release);
+
+         return *values.back();
+      }
+
+      std::atomic<const T*> current = { nullptr };
+      std::mutex mutex;
+      std::vector<std::unique_ptr<const T>> values;
+   };
+}
@@ -0,0 +1,200 @@
+#include "PlatformUtils/ExecutableResolver.h"
+
+#include <mutex>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+
+namespace OSUtils
+{
+   // Implemented per platform
+   std::string getExecutableSearchPath(); // The PATH environment variable
+   std::vector<std::filesystem::path> splitExecutableSearchPath(const std::string& searchPath);
+   std::string getExecutableLookupName(const std::filesystem::path& name);
+   std::vector<std::string> getExecutableNames(const std::filesystem::path& fileName); // The lookup names a file can be run by (none if it can't be)
+   bool isExecutableFile(const std::filesystem::path& path);
+
+   namespace
+   {
+      bool isBareName(const std::filesystem::path& name)
+      {
+         return !name.empty() && !name.has_root_path() && !name.has_parent_path() && name != "." && name != "..";
+      }
+   }
+
+   // Used by the launch functions
+   std::filesystem::path resolveExecutablePath(const std::filesystem::path& path)
+   {
+      if (!isBareName(path))
+      {
+         return path;
+      }
+
+      ExecutableResolver& executableResolver = getExecutableResolver();
+      executableResolver.update();
+
+      return executableResolver.resolve(path).value_or(path);
+   }
+
+   ExecutableResolver::~ExecutableResolver()
+   {
+      clear();
+   }
+
+   void ExecutableResolver::update()
+   {
+      // Checking only needs the shared lock, delivering needs the exclusive one (the callbacks invalidate the cache)
+      {
+         std::shared_lock<std::shared_mutex> lock(mutex);
+         if (!directoryWatcher.hasPendingEvents())
+         {
+            return;
+         }
+      }
+
+      std::unique_lock<std::shared_mutex> lock(mutex);
+      directoryWatcher.update();
+   }
+
+   std::optional<std::filesystem::path> ExecutableResolver::resolve(const std::filesystem::path& name)
+   {
+      if (!isBareName(name))
+      {
+         return name;
+      }
+
+      std::string searchPath = getExecutableSearchPath();
+      std::string lookupName = getExecutableLookupName(name);
+      {
+         std::shared_lock<std::shared_mutex> lock(mutex);
+
+         if (cachedSearchPath == searchPath)
+         {
+            auto location = entries.find(lookupName);
+            if (location == entries.end())
+            {
+               ++numHits;
+               return std::nullopt;
+            }
+
+            if (location->second.verified)
+            {
+               ++numHits;
+               return location->second.resolvedPath;
+            }
+         }
+      }
+
+      ++numMisses;
+
+      std::unique_lock<std::shared_mutex> lock(mutex);
+
+      if (cachedSearchPath != searchPath)
+      {
+         rebuild(searchPath);
+      }
+
+      auto location = entries.find(lookupName);
+      if (location == entries.end())
+      {
+         return std::nullopt;
+      }
+
+      // Listings only say what's there, whether it can actually be run is checked once it's asked for
+      Entry& entry = location->second;
+      if (!entry.verified)
+      {
+         for (const std::filesystem::path& candidate : entry.candidates)
+         {
+            if (isExecutableFile(candidate))
+            {
+               entry.resolvedPath = candidate;
+               break;
+            }
+         }
+
+         entry.verified = true;
+      }
+
+      return entry.resolvedPath;
+   }
+
+   void ExecutableResolver::clear()
+   {
+      std::unique_lock<std::shared_mutex> lock(mutex);
+      clearWithinLock();
+   }
+
+   uint64_t ExecutableResolver::getNumHits() const
+   {
+      return numHits;
+   }
+
+   uint64_t ExecutableResolver::getNumMisses() const
+   {
+      return numMisses;
+   }
+
+   void ExecutableResolver::rebuild(const std::string& searchPath)
+   {
+      clearWithinLock();
+
+      std::unordered_set<std::filesystem::path> listedDirectories;
+      for (const std::filesystem::path& directory : splitExecutableSearchPath(searchPath))
+      {
+         // Relative entries (including empty ones, meaning the current directory) would change meaning along with the working directory
+         if (!directory.is_absolute() || !listedDirectories.insert(directory.lexically_normal()).second)
+         {
+            continue;
+         }
+
+         // Start watching before listing, so that changes made in the meantime aren't missed
+         // Notifications are delivered from update(), which already holds the lock
+         DirectoryWatcher::ID id = directoryWatcher.addWatch(directory, false, [this](DirectoryWatchEvent, const std::filesystem::path&, const std::filesystem::path&)
+         {
+            // Any change could add, remove or replace an executable (or make one executable), and it's rare enough to just list everything again
+            cachedSearchPath.reset();
+         });
+
+         if (id != DirectoryWatcher::kInvalidIdentifier)
+         {
+            directoryWatches.push_back(id);
+         }
+
+         std::error_code errorCode;
+         for (std::filesystem::directory_iterator itr(directory, errorCode), end; !errorCode && itr != end; itr.increment(errorCode))
+         {
+            std::error_code typeErrorCode;
+            if (itr->is_directory(typeErrorCode))
+            {
+               continue;
+            }
+
+            for (std::string& lookupName : getExecutableNames(itr->path().filename()))
+            {
+               entries[std::move(lookupName)].candidates.push_back(itr->path());
+            }
+         }
+      }
+
+      cachedSearchPath = searchPath;
+   }
+
+   void ExecutableResolver::clearWithinLock()
+   {
+      cachedSearchPath.reset();
+      entries.clear();
+
+      for (DirectoryWatcher::ID id : directoryWatches)
+      {
+         directoryWatcher.removeWatch(id);
+      }
+      directoryWatches.clear();
+   }
+
+   ExecutableResolver& getExecutableResolver()
+   {
+      static ExecutableResolver executableResolver;
+      return executableResolver;
+   }
+}
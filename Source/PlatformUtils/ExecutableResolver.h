@@ -0,0 +1,65 @@
+#pragma once
+
+#include "OSUtils.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace OSUtils
+{
+   // Finds executables on PATH the way a shell does, from cached listings of the PATH directories, so resolving a name is a single hash lookup
+   // Everything is rebuilt when PATH changes, or when a PATH directory changes (seen through watch notifications, delivered by update())
+   class ExecutableResolver
+   {
+   public:
+      ExecutableResolver() = default;
+      ExecutableResolver(const ExecutableResolver& other) = delete;
+      ~ExecutableResolver();
+
+      ExecutableResolver& operator=(const ExecutableResolver& other) = delete;
+
+      // Processes pending file system notifications, should be called regularly (e.g. once per frame)
+      // Only takes the exclusive lock if there are any, so calling it from every launch doesn't serialize them
+      void update();
+
+      // Only bare names are looked up (anything with a directory in it is returned as is), in each absolute PATH directory in order
+      // On Windows, names are matched case insensitively, and with any of the extensions CreateProcess can run (.exe, .com, .bat, .cmd) if they're left out
+      std::optional<std::filesystem::path> resolve(const std::filesystem::path& name);
+
+      void clear();
+
+      uint64_t getNumHits() const;
+      uint64_t getNumMisses() const;
+
+   private:
+      struct Entry
+      {
+         std::vector<std::filesystem::path> candidates; // Files with the name, in PATH order
+         std::optional<std::filesystem::path> resolvedPath; // The first candidate that turned out to be executable
+         bool verified = false;
+      };
+
+      void rebuild(const std::string& searchPath);
+      void clearWithinLock();
+
+      mutable std::shared_mutex mutex;
+      DirectoryWatcher directoryWatcher;
+
+      std::optional<std::string> cachedSearchPath; // The PATH that entries were listed from, std::nullopt once they've been invalidated
+      std::unordered_map<std::string, Entry> entries;
+      std::vector<DirectoryWatcher::ID> directoryWatches;
+
+      std::atomic<uint64_t> numHits = { 0 };
+      std::atomic<uint64_t> numMisses = { 0 };
+   };
+
+   // Shared by executeProcess() and the other launch functions, which resolve bare names with it (updating it first)
+   // Names that aren't found are used as they are, so only then can a bare name refer to a file in the working directory
+   ExecutableResolver& getExecutableResolver();
+}
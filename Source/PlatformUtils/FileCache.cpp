@@ -0,0 +1,217 @@
+#include "PlatformUtils/FileCache.h"
+
+#include "PlatformUtils/IOUtils.h"
+
+#include <utility>
+
+namespace IOUtils
+{
+   namespace
+   {
+      std::filesystem::path normalizePath(const std::filesystem::path& path)
+      {
+         std::error_code errorCode;
+         std::filesystem::path absolutePath = std::filesystem::absolute(path, errorCode);
+         return errorCode ? std::filesystem::path{} : absolutePath.lexically_normal();
+      }
+   }
+
+   FileCache::FileCache(std::size_t maxBytes)
+      : maxSize(maxBytes)
+   {
+   }
+
+   FileCache::~FileCache()
+   {
+      clear();
+   }
+
+   void FileCache::update()
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      updating = true;
+      directoryWatcher.update();
+      updating = false;
+
+      for (OSUtils::DirectoryWatcher::ID id : watchesToRemove)
+      {
+         directoryWatcher.removeWatch(id);
+      }
+      watchesToRemove.clear();
+   }
+
+   FileCache::Buffer FileCache::get(const std::filesystem::path& path)
+   {
+      std::filesystem::path normalizedPath = normalizePath(path);
+      if (!normalizedPath.has_filename())
+      {
+         return nullptr;
+      }
+
+      std::filesystem::path directory = normalizedPath.parent_path();
+      uint64_t invalidationCount = 0;
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+
+         auto location = entriesByPath.find(normalizedPath);
+         if (location != entriesByPath.end())
+         {
+            entries.splice(entries.begin(), entries, location->second);
+            return location->second->buffer;
+         }
+
+         // Start watching before reading, so that changes made during the read aren't missed
+         if (!watchDirectory(directory))
+         {
+            return nullptr;
+         }
+
+         invalidationCount = invalidationCounter;
+      }
+
+      Buffer buffer;
+      if (std::optional<std::vector<uint8_t>> data = readBinaryFile(normalizedPath))
+      {
+         buffer = std::make_shared<const std::vector<uint8_t>>(std::move(*data));
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+
+      // If anything was invalidated while reading, the data might already be stale, so don't cache it
+      if (buffer && invalidationCount == invalidationCounter && buffer->size() <= maxSize && !entriesByPath.contains(normalizedPath))
+      {
+         insert(normalizedPath, buffer);
+      }
+      else
+      {
+         releaseDirectory(directory);
+      }
+
+      return buffer;
+   }
+
+   void FileCache::invalidate(const std::filesystem::path& path)
+   {
+      std::filesystem::path normalizedPath = normalizePath(path);
+
+      std::lock_guard<std::mutex> lock(mutex);
+
+      ++invalidationCounter;
+
+      auto location = entriesByPath.find(normalizedPath);
+      if (location != entriesByPath.end())
+      {
+         erase(location->second);
+      }
+   }
+
+   void FileCache::clear()
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      ++invalidationCounter;
+
+      while (!entries.empty())
+      {
+         erase(entries.begin());
+      }
+   }
+
+   std::size_t FileCache::getSize() const
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      return size;
+   }
+
+   std::size_t FileCache::getMaxBytes() const
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      return maxSize;
+   }
+
+   void FileCache::setMaxBytes(std::size_t maxBytes)
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      maxSize = maxBytes;
+      evict();
+   }
+
+   bool FileCache::watchDirectory(const std::filesystem::path& directory)
+   {
+      DirectoryWatch& watch = directoryWatches[directory];
+      if (watch.id == OSUtils::DirectoryWatcher::kInvalidIdentifier)
+      {
+         // Notifications are delivered from update(), which already holds the lock
+         watch.id = directoryWatcher.addWatch(directory, false, [this](OSUtils::DirectoryWatchEvent /* event */, const std::filesystem::path& watchedDirectory, const std::filesystem::path& file)
+         {
+            ++invalidationCounter;
+
+            auto location = entriesByPath.find((watchedDirectory / file).lexically_normal());
+            if (location != entriesByPath.end())
+            {
+               erase(location->second);
+            }
+         });
+
+         if (watch.id == OSUtils::DirectoryWatcher::kInvalidIdentifier)
+         {
+            directoryWatches.erase(directory);
+            return false;
+         }
+      }
+
+      ++watch.numEntries;
+      return true;
+   }
+
+   void FileCache::releaseDirectory(const std::filesystem::path& directory)
+   {
+      auto location = directoryWatches.find(directory);
+      if (location != directoryWatches.end() && --location->second.numEntries == 0)
+      {
+         if (updating)
+         {
+            watchesToRemove.push_back(location->second.id);
+         }
+         else
+         {
+            directoryWatcher.removeWatch(location->second.id);
+         }
+
+         directoryWatches.erase(location);
+      }
+   }
+
+   void FileCache::insert(const std::filesystem::path& path, Buffer buffer)
+   {
+      size += buffer->size();
+
+      entries.push_front(Entry{ path, std::move(buffer) });
+      entriesByPath.emplace(path, entries.begin());
+
+      evict();
+   }
+
+   void FileCache::erase(std::list<Entry>::iterator location)
+   {
+      std::filesystem::path directory = location->path.parent_path();
+
+      size -= location->buffer->size();
+      entriesByPath.erase(location->path);
+      entries.erase(location);
+
+      releaseDirectory(directory);
+   }
+
+   void FileCache::evict()
+   {
+      while (size > maxSize && !entries.empty())
+      {
+         erase(std::prev(entries.end()));
+      }
+   }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "OSUtils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace IOUtils
+{
+   // Shared cache of whole file contents, evicting the least recently used files once the byte budget is exceeded
+   // Entries are invalidated by directory watch notifications (delivered by update()), rather than by checking the file system on every access
+   class FileCache
+   {
+   public:
+      using Buffer = std::shared_ptr<const std::vector<uint8_t>>;
+
+      explicit FileCache(std::size_t maxBytes);
+      FileCache(const FileCache& other) = delete;
+      ~FileCache();
+
+      FileCache& operator=(const FileCache& other) = delete;
+
+      // Processes pending file system notifications, should be called regularly (e.g. once per frame)
+      void update();
+
+      // Returns the file's contents, reading them only if they aren't already cached (nullptr if the file can't be read, matching readBinaryFile())
+      Buffer get(const std::filesystem::path& path);
+
+      void invalidate(const std::filesystem::path& path);
+      void clear();
+
+      std::size_t getSize() const;
+      std::size_t getMaxBytes() const;
+      void setMaxBytes(std::size_t maxBytes);
+
+   private:
+      struct Entry
+      {
+         std::filesystem::path path;
+         Buffer buffer;
+      };
+
+      struct DirectoryWatch
+      {
+         OSUtils::DirectoryWatcher::ID id = OSUtils::DirectoryWatcher::kInvalidIdentifier;
+         std::size_t numEntries = 0;
+      };
+
+      bool watchDirectory(const std::filesystem::path& directory);
+      void releaseDirectory(const std::filesystem::path& directory);
+
+      void insert(const std::filesystem::path& path, Buffer buffer);
+      void erase(std::list<Entry>::iterator location);
+      void evict();
+
+      mutable std::mutex mutex;
+      OSUtils::DirectoryWatcher directoryWatcher;
+
+      std::list<Entry> entries; // Most recently used first
+      std::unordered_map<std::filesystem::path, std::list<Entry>::iterator> entriesByPath;
+      std::unordered_map<std::filesystem::path, DirectoryWatch> directoryWatches;
+      std::vector<OSUtils::DirectoryWatcher::ID> watchesToRemove; // Watches can't be removed while their notifications are being delivered
+      bool updating = false;
+
+      std::size_t size = 0;
+      std::size_t maxSize = 0;
+      uint64_t invalidationCounter = 0;
+   };
+}
@@ -0,0 +1,271 @@
+#include "PlatformUtils/HashUtils.h"
+
+#include "PlatformUtils/OSUtils.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  define PLATFORM_UTILS_HASH_X64 1
+#  include <immintrin.h>
+#  if defined(_MSC_VER) && !defined(__clang__)
+#     define PLATFORM_UTILS_TARGET_AVX2
+#  else
+#     define PLATFORM_UTILS_TARGET_AVX2 __attribute__((target("avx2")))
+#  endif
+#endif
+
+namespace HashUtils
+{
+   namespace
+   {
+      constexpr std::size_t kStripeSize = 32;
+      constexpr std::size_t kStripesPerBlock = 8;
+      constexpr std::size_t kBlockSize = kStripeSize * kStripesPerBlock;
+
+      constexpr uint64_t kPrime32 = 0x9E3779B1;
+      constexpr uint64_t kPrime64A = 0x9E3779B185EBCA87;
+      constexpr uint64_t kPrime64B = 0xC2B2AE3D27D4EB4F;
+
+      alignas(32) constexpr uint64_t kSecret[4] = { 0xBE4BA423396CFEB8, 0x1CAD21F72C81017C, 0xDB979083E96DD4DE, 0x1F67B3B7A4A44072 };
+
+      uint64_t load64(const uint8_t* data)
+      {
+         uint64_t value = 0;
+         std::memcpy(&value, data, sizeof(value));
+         return value;
+      }
+
+      uint64_t rotateLeft(uint64_t value, int amount)
+      {
+         return (value << amount) | (value >> (64 - amount));
+      }
+
+      uint64_t mix(uint64_t value)
+      {
+         value ^= value >> 33;
+         value *= kPrime64B;
+         value ^= value >> 29;
+         value *= kPrime64A;
+         value ^= value >> 32;
+         return value;
+      }
+
+      // Each stripe is processed as 4 lanes of 64 bits
+      // Every lane is multiplied (as 32 x 32 bit halves) after keying, and its raw value is added to its neighbor, so no lane can cancel itself out
+      // After each block, the accumulators are scrambled with a 32 bit multiply, which SSE2 / AVX2 can do natively
+      void accumulateStripesScalar(uint64_t* accumulators, const uint8_t* data, std::size_t numStripes)
+      {
+         for (std::size_t stripe = 0; stripe < numStripes; ++stripe)
+         {
+            const uint8_t* stripeData = data + stripe * kStripeSize;
+            for (std::size_t lane = 0; lane < 4; ++lane)
+            {
+               uint64_t value = load64(stripeData + lane * 8);
+               uint64_t keyed = value ^ kSecret[lane];
+               accumulators[lane ^ 1] += value;
+               accumulators[lane] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+            }
+         }
+      }
+
+      void accumulateBlocksScalar(uint64_t* accumulators, const uint8_t* data, std::size_t numBlocks)
+      {
+         for (std::size_t block = 0; block < numBlocks; ++block)
+         {
+            accumulateStripesScalar(accumulators, data + block * kBlockSize, kStripesPerBlock);
+
+            for (std::size_t lane = 0; lane < 4; ++lane)
+            {
+               uint64_t accumulator = accumulators[lane];
+               accumulator ^= accumulator >> 47;
+               accumulator ^= kSecret[lane];
+               accumulators[lane] = accumulator * kPrime32;
+            }
+         }
+      }
+
+#if PLATFORM_UTILS_HASH_X64
+      void accumulateBlocksSSE2(uint64_t* accumulators, const uint8_t* data, std::size_t numBlocks)
+      {
+         __m128i secretLow = _mm_load_si128(reinterpret_cast<const __m128i*>(kSecret));
+         __m128i secretHigh = _mm_load_si128(reinterpret_cast<const __m128i*>(kSecret + 2));
+         __m128i accumulatorLow = _mm_loadu_si128(reinterpret_cast<const __m128i*>(accumulators));
+         __m128i accumulatorHigh = _mm_loadu_si128(reinterpret_cast<const __m128i*>(accumulators + 2));
+
+         auto accumulate = [](__m128i accumulator, __m128i value, __m128i secret)
+         {
+            __m128i keyed = _mm_xor_si128(value, secret);
+            __m128i product = _mm_mul_epu32(keyed, _mm_srli_epi64(keyed, 32));
+            __m128i swapped = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+            return _mm_add_epi64(accumulator, _mm_add_epi64(product, swapped));
+         };
+
+         __m128i prime = _mm_set1_epi32(static_cast<int>(kPrime32));
+         auto scramble = [prime](__m128i accumulator, __m128i secret)
+         {
+            accumulator = _mm_xor_si128(accumulator, _mm_srli_epi64(accumulator, 47));
+            accumulator = _mm_xor_si128(accumulator, secret);
+            __m128i productLow = _mm_mul_epu32(accumulator, prime);
+            __m128i productHigh = _mm_mul_epu32(_mm_srli_epi64(accumulator, 32), prime);
+            return _mm_add_epi64(productLow, _mm_slli_epi64(productHigh, 32));
+         };
+
+         for (std::size_t block = 0; block < numBlocks; ++block)
+         {
+            for (std::size_t stripe = 0; stripe < kStripesPerBlock; ++stripe)
+            {
+               const __m128i* stripeData = reinterpret_cast<const __m128i*>(data + block * kBlockSize + stripe * kStripeSize);
+               accumulatorLow = accumulate(accumulatorLow, _mm_loadu_si128(stripeData), secretLow);
+               accumulatorHigh = accumulate(accumulatorHigh, _mm_loadu_si128(stripeData + 1), secretHigh);
+            }
+
+            accumulatorLow = scramble(accumulatorLow, secretLow);
+            accumulatorHigh = scramble(accumulatorHigh, secretHigh);
+         }
+
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(accumulators), accumulatorLow);
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(accumulators + 2), accumulatorHigh);
+      }
+
+      PLATFORM_UTILS_TARGET_AVX2 void accumulateBlocksAVX2(uint64_t* accumulators, const uint8_t* data, std::size_t numBlocks)
+      {
+         __m256i secret = _mm256_load_si256(reinterpret_cast<const __m256i*>(kSecret));
+         __m256i accumulator = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(accumulators));
+
+         __m256i prime = _mm256_set1_epi32(static_cast<int>(kPrime32));
+
+         for (std::size_t block = 0; block < numBlocks; ++block)
+         {
+            for (std::size_t stripe = 0; stripe < kStripesPerBlock; ++stripe)
+            {
+               __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + block * kBlockSize + stripe * kStripeSize));
+               __m256i keyed = _mm256_xor_si256(value, secret);
+               __m256i product = _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+               __m256i swapped = _mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+               accumulator = _mm256_add_epi64(accumulator, _mm256_add_epi64(product, swapped));
+            }
+
+            accumulator = _mm256_xor_si256(accumulator, _mm256_srli_epi64(accumulator, 47));
+            accumulator = _mm256_xor_si256(accumulator, secret);
+            __m256i productLow = _mm256_mul_epu32(accumulator, prime);
+            __m256i productHigh = _mm256_mul_epu32(_mm256_srli_epi64(accumulator, 32), prime);
+            accumulator = _mm256_add_epi64(productLow, _mm256_slli_epi64(productHigh, 32));
+         }
+
+         _mm256_storeu_si256(reinterpret_cast<__m256i*>(accumulators), accumulator);
+      }
+#endif
+
+      using AccumulateFunction = void(*)(uint64_t* accumulators, const uint8_t* data, std::size_t numBlocks);
+
+      AccumulateFunction selectAccumulateFunction([[maybe_unused]] HashInstructionSet instructionSet)
+      {
+#if PLATFORM_UTILS_HASH_X64
+         const OSUtils::CPUFeatures& features = OSUtils::getCPUFeatures();
+         if (features.avx2 && (instructionSet == HashInstructionSet::Best || instructionSet == HashInstructionSet::AVX2))
+         {
+            return &accumulateBlocksAVX2;
+         }
+
+         if (features.sse2 && instructionSet != HashInstructionSet::Scalar)
+         {
+            return &accumulateBlocksSSE2;
+         }
+#endif
+
+         return &accumulateBlocksScalar;
+      }
+
+      void accumulateBlocks(AccumulateFunction accumulate, uint64_t* accumulators, const uint8_t* data, std::size_t numBlocks)
+      {
+         if (numBlocks > 0)
+         {
+            accumulate(accumulators, data, numBlocks);
+         }
+      }
+   }
+
+   Hasher::Hasher(HashInstructionSet instructionSet)
+      : accumulate(selectAccumulateFunction(instructionSet))
+      , accumulators{ kPrime32, kPrime64A, kPrime64B, kPrime64A ^ kPrime64B }
+   {
+   }
+
+   void Hasher::update(std::span<const uint8_t> data)
+   {
+      // An empty span's data can be null, which memcpy() doesn't accept even for zero bytes
+      if (data.empty())
+      {
+         return;
+      }
+
+      totalSize += data.size();
+
+      if (bufferedSize > 0)
+      {
+         std::size_t numBytesToCopy = std::min(data.size(), kBlockSize - bufferedSize);
+         std::memcpy(buffer.data() + bufferedSize, data.data(), numBytesToCopy);
+         bufferedSize += numBytesToCopy;
+         data = data.subspan(numBytesToCopy);
+
+         if (bufferedSize < kBlockSize)
+         {
+            return;
+         }
+
+         accumulateBlocks(accumulate, accumulators.data(), buffer.data(), 1);
+         bufferedSize = 0;
+      }
+
+      // Hash whole blocks straight from the input
+      std::size_t numBlocks = data.size() / kBlockSize;
+      accumulateBlocks(accumulate, accumulators.data(), data.data(), numBlocks);
+      data = data.subspan(numBlocks * kBlockSize);
+
+      std::memcpy(buffer.data(), data.data(), data.size());
+      bufferedSize = data.size();
+   }
+
+   Hash128 Hasher::finish() const
+   {
+      std::array<uint64_t, 4> finalAccumulators = accumulators;
+
+      // Remaining whole stripes, then the final partial stripe padded with zeros (the total size is mixed in below, so padding is unambiguous)
+      std::size_t numStripes = bufferedSize / kStripeSize;
+      accumulateStripesScalar(finalAccumulators.data(), buffer.data(), numStripes);
+
+      std::size_t remainder = bufferedSize % kStripeSize;
+      if (remainder > 0)
+      {
+         std::array<uint8_t, kStripeSize> lastStripe{};
+         std::memcpy(lastStripe.data(), buffer.data() + numStripes * kStripeSize, remainder);
+         accumulateStripesScalar(finalAccumulators.data(), lastStripe.data(), 1);
+      }
+
+      uint64_t low = totalSize * kPrime64A;
+      uint64_t high = ~totalSize * kPrime64B;
+      for (std::size_t lane = 0; lane < 4; ++lane)
+      {
+         low = rotateLeft(low + mix(finalAccumulators[lane] ^ kSecret[lane]), 27) * kPrime64A;
+         high = rotateLeft(high + mix(finalAccumulators[lane] + kSecret[(lane + 1) % 4]), 31) * kPrime64B;
+      }
+
+      Hash128 result;
+      result.low = mix(low);
+      result.high = mix(high ^ result.low);
+      return result;
+   }
+
+   Hash128 hash(std::span<const uint8_t> data)
+   {
+      Hasher hasher;
+      hasher.update(data);
+      return hasher.finish();
+   }
+
+   Hash128 hash(std::string_view data)
+   {
+      return hash(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(data.data()), data.size()));
+   }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace HashUtils
+{
+   struct Hash128
+   {
+      uint64_t low = 0;
+      uint64_t high = 0;
+
+      bool operator==(const Hash128& other) const = default;
+   };
+
+   enum class HashInstructionSet
+   {
+      Best, // The widest one the CPU supports
+      Scalar,
+      SSE2,
+      AVX2
+   };
+
+   // Fast non-cryptographic 128-bit hash, vectorized with SSE2 / AVX2 where available
+   // Results are identical regardless of which instruction set is used, or how the input is split across update() calls
+   class Hasher
+   {
+   public:
+      // Choosing the instruction set is mostly useful for testing, one the CPU can't run falls back to the best one it can
+      explicit Hasher(HashInstructionSet instructionSet = HashInstructionSet::Best);
+
+      void update(std::span<const uint8_t> data);
+      Hash128 finish() const;
+
+   private:
+      using AccumulateFunction = void(*)(uint64_t* accumulators, const uint8_t* data, std::size_t numBlocks);
+
+      static constexpr std::size_t kStripeSize = 32;
+      static constexpr std::size_t kBlockSize = kStripeSize * 8;
+
+      AccumulateFunction accumulate = nullptr;
+      std::array<uint64_t, 4> accumulators{};
+      std::array<uint8_t, kBlockSize> buffer{};
+      std::size_t bufferedSize = 0;
+      uint64_t totalSize = 0;
+   };
+
+   Hash128 hash(std::span<const uint8_t> data);
+   Hash128 hash(std::string_view data);
+}
@@ -1,143 +1,1054 @@
 #include "PlatformUtils/IOUtils.h"
 
+#include "PlatformUtils/CachedValue.h"
 #include "PlatformUtils/OSUtils.h"
 
-#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <utility>
 
 namespace IOUtils
 {
-   std::optional<std::string> readTextFile(const std::filesystem::path& path)
+   namespace
    {
-      if (std::filesystem::is_regular_file(path))
+      const uint64_t kFileHashCacheMagic = 0x3130434855504C50; // "PLPUHC01"
+
+      template<typename Container>
+      std::span<uint8_t> getWritableBytes(Container& data, std::size_t offset, std::size_t count)
+      {
+         static_assert(sizeof(typename Container::value_type) == 1);
+         return std::span<uint8_t>(reinterpret_cast<uint8_t*>(data.data()) + offset, count);
+      }
+
+      template<typename Container>
+      bool readRemaining(OSUtils::File& file, Container& data)
       {
-         std::ifstream in(path);
-         if (in)
+         static const std::size_t kChunkSize = 64 * 1024;
+
+         while (true)
          {
-            return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            std::size_t offset = data.size();
+            data.resize(offset + kChunkSize);
+
+            std::optional<std::size_t> numBytesRead = file.read(getWritableBytes(data, offset, kChunkSize));
+            if (!numBytesRead)
+            {
+               return false;
+            }
+
+            data.resize(offset + *numBytesRead);
+            if (*numBytesRead < kChunkSize)
+            {
+               return true;
+            }
          }
       }
 
-      return std::nullopt;
-   }
+      template<typename Container>
+      std::optional<Container> readFile(const std::filesystem::path& path, Container data = Container{})
+      {
+         std::optional<OSUtils::File> file = OSUtils::openFile(path, OSUtils::FileOpenMode::Read, OSUtils::FileAccessPattern::Sequential);
+         if (!file)
+         {
+            return std::nullopt;
+         }
 
-   std::optional<std::vector<uint8_t>> readBinaryFile(const std::filesystem::path& path)
-   {
-      if (std::filesystem::is_regular_file(path))
+         std::optional<uint64_t> size = file->getSize();
+         if (!size || *size > std::numeric_limits<std::size_t>::max())
+         {
+            return std::nullopt;
+         }
+
+         if (*size > 0)
+         {
+            data.resize(static_cast<std::size_t>(*size));
+
+            std::optional<std::size_t> numBytesRead = file->read(getWritableBytes(data, 0, data.size()));
+            if (!numBytesRead)
+            {
+               return std::nullopt;
+            }
+
+            data.resize(*numBytesRead);
+         }
+         else if (!readRemaining(*file, data)) // Some special files report a size of zero, but still have contents
+         {
+            return std::nullopt;
+         }
+
+         return data;
+      }
+
+      // Renaming over a symlink would replace the link itself, so atomic / durable writes replace the file it points to instead (plain writes go through it anyway)
+      // Links to files that don't exist yet are followed too (plain writes would create the file they point to)
+      std::filesystem::path getWriteTarget(const std::filesystem::path& path, const WriteOptions& options)
       {
-         std::ifstream in(path, std::ifstream::binary);
-         if (in)
+         static const int kMaxLinks = 40; // Like the kernel, anything longer is most likely a loop
+
+         if (options.mode == WriteMode::Plain)
          {
-            std::streampos start = in.tellg();
-            in.seekg(0, std::ios_base::end);
-            std::streamoff size = in.tellg() - start;
+            return path;
+         }
+
+         std::filesystem::path target = path;
+         std::error_code errorCode;
+         for (int i = 0; i < kMaxLinks && std::filesystem::is_symlink(std::filesystem::symlink_status(target, errorCode)); ++i)
+         {
+            std::filesystem::path linkTarget = std::filesystem::read_symlink(target, errorCode);
+            if (errorCode)
+            {
+               return path;
+            }
+
+            target = target.parent_path() / linkTarget; // Relative to the link's directory (absolute targets replace it)
+         }
+
+         return target;
+      }
 
-            if (size > 0)
+      // The path has to have gone through getWriteTarget() already
+      std::optional<OSUtils::File> beginWrite(const std::filesystem::path& path, const WriteOptions& options)
+      {
+         if (path.has_filename())
+         {
+            std::error_code errorCode;
+            std::filesystem::create_directories(path.parent_path(), errorCode);
+            if (!errorCode)
             {
-               in.seekg(0, std::ios_base::beg);
+               if (options.mode == WriteMode::Plain)
+               {
+                  return OSUtils::openFile(path, OSUtils::FileOpenMode::Write, OSUtils::FileAccessPattern::Sequential);
+               }
 
-               std::vector<uint8_t> data(static_cast<size_t>(size));
-               in.read(reinterpret_cast<char*>(data.data()), size);
+               // Replacing a file keeps its permissions (new files get the defaults, like with plain writes)
+               std::optional<OSUtils::File> file = OSUtils::createTemporaryFile(path.parent_path());
+               std::filesystem::file_status status = std::filesystem::status(path, errorCode);
+               if (file && !errorCode && std::filesystem::exists(status) && !file->setPermissions(status.permissions()))
+               {
+                  return std::nullopt;
+               }
 
-               return data;
+               return file;
             }
          }
+
+         return std::nullopt;
       }
 
-      return std::nullopt;
-   }
+      bool endWrite(OSUtils::File& file, const std::filesystem::path& path, const WriteOptions& options)
+      {
+         if (options.mode == WriteMode::Plain)
+         {
+            return true;
+         }
 
-   bool writeTextFile(const std::filesystem::path& path, std::string_view data)
-   {
-      if (path.has_filename())
+         bool durable = options.mode == WriteMode::Durable;
+         if (durable && !file.sync())
+         {
+            return false;
+         }
+
+         if (!OSUtils::commitTemporaryFile(file, path))
+         {
+            return false;
+         }
+
+         return !durable || OSUtils::syncDirectory(path.parent_path());
+      }
+
+      bool writeFile(const std::filesystem::path& path, std::span<const uint8_t> data, const WriteOptions& options)
       {
-         std::error_code errorCode;
-         std::filesystem::create_directories(path.parent_path(), errorCode);
-         if (!errorCode)
+         std::filesystem::path target = getWriteTarget(path, options);
+         std::optional<OSUtils::File> file = beginWrite(target, options);
+         return file && file->writeAt(0, data) && endWrite(*file, target, options);
+      }
+
+      bool writeFile(const std::filesystem::path& path, std::span<const std::span<const uint8_t>> fragments, const WriteOptions& options)
+      {
+         // Freshly created / truncated, so the current position is the start of the file
+         std::filesystem::path target = getWriteTarget(path, options);
+         std::optional<OSUtils::File> file = beginWrite(target, options);
+         return file && file->write(fragments) && endWrite(*file, target, options);
+      }
+
+      // Each worker pops directories from the back of its own queue, and idle workers steal from the front of the others' queues
+      class DirectoryEnumerator
+      {
+      public:
+         DirectoryEnumerator(const EnumerateDirectoryOptions& enumerateOptions, std::size_t numWorkers)
+            : options(enumerateOptions)
+            , workers(numWorkers)
+         {
+         }
+
+         bool listRoot(const std::filesystem::path& directory)
          {
-            std::ofstream out(path);
-            if (out)
+            return list(workers[0], directory);
+         }
+
+         bool hasPendingDirectories() const
+         {
+            return numPending > 0;
+         }
+
+         void run(std::size_t workerIndex)
+         {
+            Worker& worker = workers[workerIndex];
+
+            while (true)
             {
-               out << data;
-               return true;
+               if (std::optional<std::filesystem::path> directory = take(workerIndex))
+               {
+                  list(worker, *directory);
+
+                  if (--numPending == 0)
+                  {
+                     std::lock_guard<std::mutex> lock(idleMutex);
+                     idleCondition.notify_all();
+                  }
+
+                  continue;
+               }
+
+               std::unique_lock<std::mutex> lock(idleMutex);
+               ++numIdle;
+               idleCondition.wait(lock, [this]() { return numPending == 0 || numQueued > 0; });
+               --numIdle;
+
+               if (numPending == 0)
+               {
+                  return;
+               }
             }
          }
-      }
 
-      return false;
-   }
+         std::vector<DirectoryEntry> getEntries()
+         {
+            std::vector<DirectoryEntry> entries = std::move(workers[0].entries);
+            for (std::size_t i = 1; i < workers.size(); ++i)
+            {
+               entries.insert(entries.end(), std::make_move_iterator(workers[i].entries.begin()), std::make_move_iterator(workers[i].entries.end()));
+            }
 
-   bool writeBinaryFile(const std::filesystem::path& path, const std::vector<uint8_t>& data)
-   {
-      if (path.has_filename())
+            return entries;
+         }
+
+      private:
+         struct Worker
+         {
+            std::mutex mutex;
+            std::deque<std::filesystem::path> directories;
+            std::vector<DirectoryEntry> entries;
+         };
+
+         bool list(Worker& worker, const std::filesystem::path& directory)
+         {
+            return OSUtils::listDirectory(directory, [this, &worker, &directory](auto name, OSUtils::DirectoryEntryType type)
+            {
+               DirectoryEntry entry{ directory / name, type };
+               if (options.filter && !options.filter(entry))
+               {
+                  return;
+               }
+
+               if (options.recursive && type == OSUtils::DirectoryEntryType::Directory)
+               {
+                  push(worker, entry.path);
+               }
+
+               worker.entries.push_back(std::move(entry));
+            });
+         }
+
+         void push(Worker& worker, const std::filesystem::path& directory)
+         {
+            ++numPending;
+            {
+               std::lock_guard<std::mutex> lock(worker.mutex);
+               worker.directories.push_back(directory);
+               ++numQueued;
+            }
+
+            if (numIdle > 0)
+            {
+               std::lock_guard<std::mutex> lock(idleMutex);
+               idleCondition.notify_one();
+            }
+         }
+
+         std::optional<std::filesystem::path> take(std::size_t workerIndex)
+         {
+            if (numQueued == 0)
+            {
+               return std::nullopt;
+            }
+
+            for (std::size_t i = 0; i < workers.size(); ++i)
+            {
+               Worker& worker = workers[(workerIndex + i) % workers.size()];
+               bool own = i == 0;
+
+               std::lock_guard<std::mutex> lock(worker.mutex);
+               if (!worker.directories.empty())
+               {
+                  std::filesystem::path directory;
+                  if (own)
+                  {
+                     // Depth first for our own work keeps the queues short
+                     directory = std::move(worker.directories.back());
+                     worker.directories.pop_back();
+                  }
+                  else
+                  {
+                     // Stealing from the front takes the shallowest directories, which are likely to have the most work under them
+                     directory = std::move(worker.directories.front());
+                     worker.directories.pop_front();
+                  }
+
+                  --numQueued;
+                  return directory;
+               }
+            }
+
+            return std::nullopt;
+         }
+
+         const EnumerateDirectoryOptions& options;
+         std::vector<Worker> workers;
+
+         std::atomic<std::size_t> numPending = { 0 }; // Queued or being listed
+         std::atomic<std::size_t> numQueued = { 0 };
+         std::atomic<std::size_t> numIdle = { 0 };
+         std::mutex idleMutex;
+         std::condition_variable idleCondition;
+      };
+
+      std::optional<std::filesystem::path> searchForProjectDirectory()
       {
-         std::error_code errorCode;
-         std::filesystem::create_directories(path.parent_path(), errorCode);
-         if (!errorCode)
+         std::optional<std::filesystem::path> projectDirectory;
+
+         if (std::optional<std::filesystem::path> executeablePath = OSUtils::getExecutablePath())
          {
-            std::ofstream out(path, std::ofstream::binary);
-            if (out)
+            static const char* kCMakeListsName = "CMakeLists.txt";
+            static const int kNumDirectoriesToClimb = 2;
+
+            // The project directory location depends on the build / install environment
+            std::filesystem::path executableDirectory = executeablePath->parent_path();
+
+            // First, look for CMakeLists.txt
+            std::filesystem::path potentialProjectDirectory = executableDirectory;
+            for (int i = 0; i <= kNumDirectoriesToClimb; ++i)
             {
-               out.write(reinterpret_cast<const char*>(data.data()), data.size());
-               return true;
+               if (std::filesystem::is_directory(potentialProjectDirectory))
+               {
+                  std::filesystem::path potentialCMakeListsPath = potentialProjectDirectory / kCMakeListsName;
+                  if (std::filesystem::is_regular_file(potentialCMakeListsPath))
+                  {
+                     std::error_code errorCode;
+                     std::filesystem::path canonicalProjectDirectory = std::filesystem::canonical(potentialProjectDirectory, errorCode);
+                     if (!errorCode)
+                     {
+                        projectDirectory = canonicalProjectDirectory;
+                        break;
+                     }
+                  }
+
+                  potentialProjectDirectory = potentialProjectDirectory.parent_path();
+               }
+            }
+
+            // If it can't be found, assume the project has been installed, and the project directory is the same as the executable directory
+            if (!projectDirectory && std::filesystem::is_directory(executableDirectory))
+            {
+               std::error_code errorCode;
+               std::filesystem::path canonicalProjectDirectory = std::filesystem::canonical(executableDirectory, errorCode);
+               if (!errorCode)
+               {
+                  projectDirectory = canonicalProjectDirectory;
+               }
             }
          }
+
+         return projectDirectory;
       }
 
-      return false;
+      OSUtils::CachedValue<std::optional<std::filesystem::path>> cachedProjectDirectory;
    }
 
-   std::optional<std::filesystem::path> findProjectDirectory()
+   std::optional<std::string> readTextFile(const std::filesystem::path& path)
    {
-      static std::optional<std::filesystem::path> cachedProjectDirectory;
+      return readFile<std::string>(path);
+   }
 
-      if (cachedProjectDirectory)
+   std::optional<std::vector<uint8_t>> readBinaryFile(const std::filesystem::path& path)
+   {
+      std::optional<std::vector<uint8_t>> data = readFile<std::vector<uint8_t>>(path);
+      if (data && data->empty())
       {
-         return cachedProjectDirectory;
+         return std::nullopt;
       }
 
-      if (std::optional<std::filesystem::path> executeablePath = OSUtils::getExecutablePath())
+      return data;
+   }
+
+   std::optional<std::pmr::string> readTextFile(const std::filesystem::path& path, std::pmr::memory_resource* resource)
+   {
+      return readFile(path, std::pmr::string(resource));
+   }
+
+   std::optional<std::pmr::vector<uint8_t>> readBinaryFile(const std::filesystem::path& path, std::pmr::memory_resource* resource)
+   {
+      std::optional<std::pmr::vector<uint8_t>> data = readFile(path, std::pmr::vector<uint8_t>(resource));
+      if (data && data->empty())
       {
-         static const char* kCMakeListsName = "CMakeLists.txt";
-         static const int kNumDirectoriesToClimb = 2;
+         return std::nullopt;
+      }
 
-         // The project directory location depends on the build / install environment
-         std::filesystem::path executableDirectory = executeablePath->parent_path();
+      return data;
+   }
 
-         // First, look for CMakeLists.txt
-         std::filesystem::path potentialProjectDirectory = executableDirectory;
-         for (int i = 0; i <= kNumDirectoriesToClimb; ++i)
+   std::optional<std::size_t> readBinaryFile(const std::filesystem::path& path, std::span<uint8_t> buffer)
+   {
+      std::optional<OSUtils::File> file = OSUtils::openFile(path, OSUtils::FileOpenMode::Read, OSUtils::FileAccessPattern::Sequential);
+      std::optional<uint64_t> size = file ? file->getSize() : std::nullopt;
+      if (!size || *size > buffer.size())
+      {
+         return std::nullopt;
+      }
+
+      std::optional<std::size_t> numBytesRead = file->read(buffer.first(*size > 0 ? static_cast<std::size_t>(*size) : buffer.size()));
+      if (!numBytesRead || *numBytesRead == 0)
+      {
+         return std::nullopt;
+      }
+
+      return numBytesRead;
+   }
+
+   std::optional<OSUtils::MappedFile> mapBinaryFile(const std::filesystem::path& path, const OSUtils::MapFileOptions& options)
+   {
+      return OSUtils::mapFile(path, options);
+   }
+
+   std::optional<ValidatedText> readValidatedTextFile(const std::filesystem::path& path, const TextReadOptions& options)
+   {
+      // Small enough that each chunk is still in cache when it's validated
+      static const std::size_t kChunkSize = 256 * 1024;
+
+      std::optional<OSUtils::File> file = OSUtils::openFile(path, OSUtils::FileOpenMode::Read, OSUtils::FileAccessPattern::Sequential);
+      std::optional<uint64_t> size = file ? file->getSize() : std::nullopt;
+      if (!size || *size > std::numeric_limits<std::size_t>::max() - kChunkSize)
+      {
+         return std::nullopt;
+      }
+
+      ValidatedText result;
+      std::string& text = result.text;
+      text.reserve(static_cast<std::size_t>(*size) + kChunkSize);
+
+      std::optional<TextUtils::ByteOrderMark> byteOrderMark;
+      bool checkedByteOrderMark = false;
+      TextUtils::UTF8Validator validator;
+      std::size_t length = 0;
+      std::size_t validatedLength = 0;
+
+      while (true)
+      {
+         text.resize(length + kChunkSize);
+
+         std::optional<std::size_t> numBytesRead = file->read(getWritableBytes(text, length, kChunkSize));
+         if (!numBytesRead)
+         {
+            return std::nullopt;
+         }
+
+         length += *numBytesRead;
+         bool reachedEnd = *numBytesRead < kChunkSize;
+
+         if (!checkedByteOrderMark && (length >= 3 || reachedEnd))
          {
-            if (std::filesystem::is_directory(potentialProjectDirectory))
+            checkedByteOrderMark = true;
+
+            byteOrderMark = TextUtils::detectByteOrderMark(std::string_view(text.data(), length));
+            if (byteOrderMark)
             {
-               std::filesystem::path potentialCMakeListsPath = potentialProjectDirectory / kCMakeListsName;
-               if (std::filesystem::is_regular_file(potentialCMakeListsPath))
+               result.sourceEncoding = byteOrderMark->encoding;
+               result.hadByteOrderMark = true;
+
+               if (byteOrderMark->encoding == TextUtils::TextEncoding::UTF8)
                {
-                  std::error_code errorCode;
-                  std::filesystem::path canonicalProjectDirectory = std::filesystem::canonical(potentialProjectDirectory, errorCode);
-                  if (!errorCode)
+                  // Still within the first chunk, so this is cheap
+                  if (options.stripByteOrderMark)
+                  {
+                     text.erase(0, byteOrderMark->size);
+                     length -= byteOrderMark->size;
+                  }
+                  else
                   {
-                     cachedProjectDirectory = canonicalProjectDirectory;
-                     break;
+                     validatedLength = byteOrderMark->size;
                   }
                }
+            }
+         }
 
-               potentialProjectDirectory = potentialProjectDirectory.parent_path();
+         if (checkedByteOrderMark && result.sourceEncoding == TextUtils::TextEncoding::UTF8)
+         {
+            if (!validator.update(std::string_view(text.data() + validatedLength, length - validatedLength)))
+            {
+               return std::nullopt;
             }
+
+            validatedLength = length;
          }
 
-         // If it can't be found, assume the project has been installed, and the project directory is the same as the executable directory
-         if (!cachedProjectDirectory && std::filesystem::is_directory(executableDirectory))
+         if (reachedEnd)
          {
-            std::error_code errorCode;
-            std::filesystem::path canonicalProjectDirectory = std::filesystem::canonical(executableDirectory, errorCode);
-            if (!errorCode)
+            break;
+         }
+      }
+
+      text.resize(length);
+
+      if (result.sourceEncoding == TextUtils::TextEncoding::UTF8)
+      {
+         return validator.finish() ? std::optional<ValidatedText>(std::move(result)) : std::nullopt;
+      }
+
+      if (!options.convertUTF16)
+      {
+         return std::nullopt;
+      }
+
+      // Converting always drops the byte order mark, since it only describes the original encoding
+      std::optional<std::string> convertedText = TextUtils::convertUTF16ToUTF8(std::string_view(text).substr(byteOrderMark->size), result.sourceEncoding);
+      if (!convertedText)
+      {
+         return std::nullopt;
+      }
+
+      text = std::move(*convertedText);
+      return result;
+   }
+
+   void readFilesBatch(std::span<const std::filesystem::path> paths, const OSUtils::AsyncReadFunction& function, std::size_t queueDepth)
+   {
+      auto complete = [&paths, &function](std::size_t index, std::optional<std::vector<uint8_t>> data)
+      {
+         if (data && data->empty())
+         {
+            // Either actually empty, or a special file that needs to be read in chunks
+            data = readBinaryFile(paths[index]);
+         }
+
+         function(index, std::move(data));
+      };
+
+      if (paths.empty() || OSUtils::readFilesAsync(paths, queueDepth, complete))
+      {
+         return;
+      }
+
+      std::mutex mutex;
+      std::condition_variable cv;
+      std::vector<std::pair<std::size_t, std::optional<std::vector<uint8_t>>>> results;
+      std::atomic<std::size_t> nextIndex = { 0 };
+
+      auto work = [&]()
+      {
+         for (std::size_t index = nextIndex++; index < paths.size(); index = nextIndex++)
+         {
+            std::optional<std::vector<uint8_t>> data = readBinaryFile(paths[index]);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            results.emplace_back(index, std::move(data));
+            cv.notify_one();
+         }
+      };
+
+      std::size_t numThreads = std::clamp<std::size_t>(std::min(queueDepth, paths.size()), 1, std::max(std::thread::hardware_concurrency(), 1u) * 4);
+      std::vector<std::thread> threads;
+      threads.reserve(numThreads);
+      for (std::size_t i = 0; i < numThreads; ++i)
+      {
+         threads.emplace_back(work);
+      }
+
+      std::vector<std::pair<std::size_t, std::optional<std::vector<uint8_t>>>> completedResults;
+      for (std::size_t numCompleted = 0; numCompleted < paths.size(); numCompleted += completedResults.size())
+      {
+         completedResults.clear();
+         {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&results]() { return !results.empty(); });
+            std::swap(results, completedResults);
+         }
+
+         for (auto& [index, data] : completedResults)
+         {
+            function(index, std::move(data));
+         }
+      }
+
+      for (std::thread& thread : threads)
+      {
+         thread.join();
+      }
+   }
+
+   std::vector<std::optional<std::vector<uint8_t>>> readFilesBatch(std::span<const std::filesystem::path> paths, std::size_t queueDepth)
+   {
+      std::vector<std::optional<std::vector<uint8_t>>> results(paths.size());
+
+      readFilesBatch(paths, [&results](std::size_t index, std::optional<std::vector<uint8_t>> data)
+      {
+         results[index] = std::move(data);
+      }, queueDepth);
+
+      return results;
+   }
+
+   bool writeTextFile(const std::filesystem::path& path, std::string_view data, const WriteOptions& options)
+   {
+      return writeFile(path, std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(data.data()), data.size()), options);
+   }
+
+   bool writeBinaryFile(const std::filesystem::path& path, const std::vector<uint8_t>& data, const WriteOptions& options)
+   {
+      return writeFile(path, std::span<const uint8_t>(data), options);
+   }
+
+   bool writeBinaryFile(const std::filesystem::path& path, std::span<const uint8_t> data, const WriteOptions& options)
+   {
+      return writeFile(path, data, options);
+   }
+
+   bool writeBinaryFile(const std::filesystem::path& path, std::span<const std::span<const uint8_t>> fragments, const WriteOptions& options)
+   {
+      return writeFile(path, fragments, options);
+   }
+
+   FileReader::FileReader(const std::filesystem::path& path, std::size_t chunkSize)
+      : file(OSUtils::openFile(path, OSUtils::FileOpenMode::Read, OSUtils::FileAccessPattern::Sequential))
+   {
+      if (file)
+      {
+         ownedBuffer.resize(std::max<std::size_t>(chunkSize, 1));
+         buffer = ownedBuffer;
+      }
+   }
+
+   FileReader::FileReader(const std::filesystem::path& path, std::span<uint8_t> chunkBuffer)
+      : file(OSUtils::openFile(path, OSUtils::FileOpenMode::Read, OSUtils::FileAccessPattern::Sequential))
+      , buffer(chunkBuffer)
+   {
+   }
+
+   std::optional<std::span<const uint8_t>> FileReader::readChunk()
+   {
+      if (std::optional<std::size_t> numBytesRead = read(buffer))
+      {
+         return buffer.first(*numBytesRead);
+      }
+
+      return std::nullopt;
+   }
+
+   std::optional<std::size_t> FileReader::read(std::span<uint8_t> destination)
+   {
+      if (!file || destination.empty())
+      {
+         return std::nullopt;
+      }
+
+      return file->read(destination);
+   }
+
+   bool FileReader::forEachChunk(const ChunkFunction& function)
+   {
+      while (std::optional<std::span<const uint8_t>> chunk = readChunk())
+      {
+         if (chunk->empty() || !function(*chunk))
+         {
+            return true;
+         }
+      }
+
+      return false;
+   }
+
+   FileWriter::FileWriter(const std::filesystem::path& filePath, const WriteOptions& writeOptions, std::size_t bufferSize)
+      : path(getWriteTarget(filePath, writeOptions))
+      , options(writeOptions)
+      , file(beginWrite(path, writeOptions))
+   {
+      if (file)
+      {
+         ownedBuffer.resize(bufferSize);
+         buffer = ownedBuffer;
+      }
+   }
+
+   FileWriter::FileWriter(const std::filesystem::path& filePath, std::span<uint8_t> writeBuffer, const WriteOptions& writeOptions)
+      : path(getWriteTarget(filePath, writeOptions))
+      , options(writeOptions)
+      , file(beginWrite(path, writeOptions))
+      , buffer(writeBuffer)
+   {
+   }
+
+   FileWriter::FileWriter(FileWriter&& other)
+      : path(std::move(other.path))
+      , options(other.options)
+      , file(std::exchange(other.file, std::nullopt))
+      , ownedBuffer(std::move(other.ownedBuffer))
+      , buffer(std::exchange(other.buffer, {}))
+      , bufferedSize(std::exchange(other.bufferedSize, 0))
+      , failed(other.failed)
+   {
+   }
+
+   FileWriter::~FileWriter()
+   {
+      close();
+   }
+
+   FileWriter& FileWriter::operator=(FileWriter&& other)
+   {
+      if (this != &other)
+      {
+         close();
+
+         path = std::move(other.path);
+         options = other.options;
+         file = std::exchange(other.file, std::nullopt);
+         ownedBuffer = std::move(other.ownedBuffer);
+         buffer = std::exchange(other.buffer, {});
+         bufferedSize = std::exchange(other.bufferedSize, 0);
+         failed = other.failed;
+      }
+
+      return *this;
+   }
+
+   bool FileWriter::write(std::span<const uint8_t> data)
+   {
+      if (!file || failed)
+      {
+         return false;
+      }
+
+      if (bufferedSize + data.size() > buffer.size())
+      {
+         if (!flush())
+         {
+            return false;
+         }
+
+         // Too big to be worth buffering, write it directly
+         if (data.size() >= buffer.size())
+         {
+            failed = !file->write(data);
+            return !failed;
+         }
+      }
+
+      std::copy(data.begin(), data.end(), buffer.begin() + bufferedSize);
+      bufferedSize += data.size();
+
+      return true;
+   }
+
+   bool FileWriter::flush()
+   {
+      if (!file || failed)
+      {
+         return false;
+      }
+
+      if (bufferedSize > 0)
+      {
+         failed = !file->write(buffer.first(bufferedSize));
+         bufferedSize = 0;
+      }
+
+      return !failed;
+   }
+
+   bool FileWriter::close()
+   {
+      if (!file)
+      {
+         return false;
+      }
+
+      bool succeeded = flush() && endWrite(*file, path, options);
+
+      file.reset();
+      return succeeded;
+   }
+
+   std::optional<std::vector<DirectoryEntry>> enumerateDirectory(const std::filesystem::path& directory, const EnumerateDirectoryOptions& options)
+   {
+      std::size_t numThreads = options.numThreads > 0 ? options.numThreads : std::max(std::thread::hardware_concurrency(), 1u);
+      if (!options.recursive)
+      {
+         numThreads = 1;
+      }
+
+      DirectoryEnumerator enumerator(options, numThreads);
+      if (!enumerator.listRoot(directory))
+      {
+         return std::nullopt;
+      }
+
+      // Only start up the other workers if there's something to share
+      if (enumerator.hasPendingDirectories())
+      {
+         std::vector<std::thread> threads;
+         threads.reserve(numThreads - 1);
+         for (std::size_t i = 1; i < numThreads; ++i)
+         {
+            threads.emplace_back([&enumerator, i]() { enumerator.run(i); });
+         }
+
+         enumerator.run(0);
+
+         for (std::thread& thread : threads)
+         {
+            thread.join();
+         }
+      }
+
+      return enumerator.getEntries();
+   }
+
+   std::optional<CopyMethod> copyFile(const std::filesystem::path& source, const std::filesystem::path& destination, const WriteOptions& options)
+   {
+      std::optional<OSUtils::File> sourceFile = OSUtils::openFile(source, OSUtils::FileOpenMode::Read, OSUtils::FileAccessPattern::Sequential);
+      std::optional<uint64_t> size = sourceFile ? sourceFile->getSize() : std::nullopt;
+      if (!size)
+      {
+         return std::nullopt;
+      }
+
+      // Opening the destination would truncate the source if they're the same file (e.g. hard links to it), like std::filesystem::copy_file() that's an error
+      std::error_code errorCode;
+      if (std::filesystem::equivalent(source, destination, errorCode))
+      {
+         return std::nullopt;
+      }
+
+      std::filesystem::file_status sourceStatus = std::filesystem::status(source, errorCode);
+      if (errorCode)
+      {
+         return std::nullopt;
+      }
+
+      std::filesystem::path target = getWriteTarget(destination, options);
+      std::optional<OSUtils::File> destinationFile = beginWrite(target, options);
+      if (!destinationFile)
+      {
+         return std::nullopt;
+      }
+
+      std::optional<CopyMethod> method;
+      if (*size == 0)
+      {
+         method = CopyMethod::Buffered; // Nothing to copy, creating the destination was enough
+      }
+      else if (OSUtils::cloneFileContents(*sourceFile, *destinationFile))
+      {
+         method = CopyMethod::Clone;
+      }
+      else if (OSUtils::copyFileContents(*sourceFile, *destinationFile, *size))
+      {
+         method = CopyMethod::Kernel;
+      }
+      else
+      {
+         static const std::size_t kBufferSize = 1024 * 1024;
+
+         // Failed kernel copies may have written part of the file, so write from the start, at explicit offsets
+         std::vector<uint8_t> buffer(static_cast<std::size_t>(std::min<uint64_t>(*size, kBufferSize)));
+         uint64_t offset = 0;
+         while (std::optional<std::size_t> numBytesRead = sourceFile->read(buffer))
+         {
+            if (*numBytesRead == 0)
             {
-               cachedProjectDirectory = canonicalProjectDirectory;
+               method = CopyMethod::Buffered;
+               break;
             }
+
+            if (!destinationFile->writeAt(offset, std::span<const uint8_t>(buffer).first(*numBytesRead)))
+            {
+               break;
+            }
+
+            offset += *numBytesRead;
          }
       }
 
-      return cachedProjectDirectory;
+      // Like std::filesystem::copy_file(), the copy gets the source's permissions (keeping it executable, for example)
+      if (!method || !destinationFile->setPermissions(sourceStatus.permissions()) || !endWrite(*destinationFile, target, options))
+      {
+         return std::nullopt;
+      }
+
+      return method;
+   }
+
+   bool FileHashCache::load(const std::filesystem::path& path)
+   {
+      static const std::size_t kValuesPerEntry = 6;
+
+      std::optional<std::vector<uint8_t>> data = readBinaryFile(path);
+      if (!data || data->size() < sizeof(uint64_t) * 2)
+      {
+         return false;
+      }
+
+      std::vector<uint64_t> values(data->size() / sizeof(uint64_t));
+      std::memcpy(values.data(), data->data(), values.size() * sizeof(uint64_t));
+
+      uint64_t numEntries = values[1];
+      if (values[0] != kFileHashCacheMagic || numEntries > (values.size() - 2) / kValuesPerEntry)
+      {
+         return false;
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+
+      entries.clear();
+      entries.reserve(static_cast<std::size_t>(numEntries));
+      for (std::size_t i = 0; i < numEntries; ++i)
+      {
+         const uint64_t* entryValues = &values[2 + i * kValuesPerEntry];
+
+         Key key;
+         key.device = entryValues[0];
+         key.inode = entryValues[1];
+
+         Entry entry;
+         entry.size = entryValues[2];
+         entry.modificationTime = static_cast<int64_t>(entryValues[3]);
+         entry.hash.low = entryValues[4];
+         entry.hash.high = entryValues[5];
+
+         entries.emplace(key, entry);
+      }
+
+      return true;
+   }
+
+   bool FileHashCache::save(const std::filesystem::path& path) const
+   {
+      std::vector<uint64_t> values;
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+
+         values.reserve(2 + entries.size() * 6);
+         values.push_back(kFileHashCacheMagic);
+         values.push_back(entries.size());
+         for (const auto& [key, entry] : entries)
+         {
+            values.insert(values.end(), { key.device, key.inode, entry.size, static_cast<uint64_t>(entry.modificationTime), entry.hash.low, entry.hash.high });
+         }
+      }
+
+      std::vector<uint8_t> data(values.size() * sizeof(uint64_t));
+      std::memcpy(data.data(), values.data(), data.size());
+
+      return writeBinaryFile(path, data, { WriteMode::Atomic });
+   }
+
+   std::optional<HashUtils::Hash128> FileHashCache::find(const OSUtils::FileInfo& info) const
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      auto location = entries.find(Key{ info.device, info.inode });
+      if (location != entries.end() && location->second.size == info.size && location->second.modificationTime == info.modificationTime)
+      {
+         return location->second.hash;
+      }
+
+      return std::nullopt;
+   }
+
+   void FileHashCache::store(const OSUtils::FileInfo& info, const HashUtils::Hash128& hash)
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      entries.insert_or_assign(Key{ info.device, info.inode }, Entry{ info.size, info.modificationTime, hash });
+   }
+
+   void FileHashCache::clear()
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      entries.clear();
+   }
+
+   std::optional<HashUtils::Hash128> hashFile(const std::filesystem::path& path, FileHashCache* cache)
+   {
+      std::optional<OSUtils::FileInfo> info = OSUtils::getFileInfo(path);
+      if (!info)
+      {
+         return std::nullopt;
+      }
+
+      if (cache)
+      {
+         if (std::optional<HashUtils::Hash128> cachedHash = cache->find(*info))
+         {
+            return cachedHash;
+         }
+      }
+
+      std::optional<HashUtils::Hash128> hash;
+      if (std::optional<OSUtils::MappedFile> mappedFile = OSUtils::mapFile(path, { OSUtils::FileAccessPattern::Sequential }))
+      {
+         hash = HashUtils::hash(mappedFile->getData());
+      }
+      else
+      {
+         // Empty or special files can't be mapped
+         FileReader reader(path);
+         HashUtils::Hasher hasher;
+         if (reader.forEachChunk([&hasher](std::span<const uint8_t> chunk) { hasher.update(chunk); return true; }))
+         {
+            hash = hasher.finish();
+         }
+      }
+
+      // Files modified within the timestamp granularity could change again without their modification time changing, so don't trust those
+      static const int64_t kRacyModificationWindow = 2'000'000'000;
+      int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+      if (cache && hash && now - info->modificationTime > kRacyModificationWindow)
+      {
+         cache->store(*info, *hash);
+      }
+
+      return hash;
+   }
+
+   std::optional<std::filesystem::path> findProjectDirectory()
+   {
+      return cachedProjectDirectory.get([]() { return searchForProjectDirectory(); });
+   }
+
+   void refreshCachedPaths()
+   {
+      OSUtils::refreshCachedPaths();
+      cachedProjectDirectory.refresh();
    }
 
    std::optional<std::filesystem::path> getAbsolutePath(const std::filesystem::path& base, const std::filesystem::path& relativePath)
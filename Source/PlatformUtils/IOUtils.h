@@ -1,24 +1,223 @@
 #pragma once
 
+#include "HashUtils.h"
 #include "OSUtils.h"
+#include "TextUtils.h"
 
 #include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace IOUtils
 {
+   enum class WriteMode
+   {
+      Plain, // Truncate and write in place, a crash can leave a partially written file
+      Atomic, // Write to a temporary file and rename it into place, readers see either the old or the new contents (a symlink is followed, replacing the file it points to)
+      Durable // Atomic, and flushes the file and its directory to the storage device before returning
+   };
+
+   struct WriteOptions
+   {
+      WriteMode mode = WriteMode::Plain;
+   };
+
    std::optional<std::string> readTextFile(const std::filesystem::path& path);
    std::optional<std::vector<uint8_t>> readBinaryFile(const std::filesystem::path& path);
 
-   bool writeTextFile(const std::filesystem::path& path, std::string_view data);
-   bool writeBinaryFile(const std::filesystem::path& path, const std::vector<uint8_t>& data);
+   // Allocates from the given memory resource
+   std::optional<std::pmr::string> readTextFile(const std::filesystem::path& path, std::pmr::memory_resource* resource);
+   std::optional<std::pmr::vector<uint8_t>> readBinaryFile(const std::filesystem::path& path, std::pmr::memory_resource* resource);
+
+   // Reads into the caller's buffer, returning the number of bytes read (std::nullopt if the file doesn't fit, special files of unknown size are truncated)
+   // Like the other overloads, empty files give std::nullopt
+   std::optional<std::size_t> readBinaryFile(const std::filesystem::path& path, std::span<uint8_t> buffer);
+   std::optional<OSUtils::MappedFile> mapBinaryFile(const std::filesystem::path& path, const OSUtils::MapFileOptions& options = {});
+
+   struct TextReadOptions
+   {
+      bool stripByteOrderMark = true;
+      bool convertUTF16 = true; // Otherwise, UTF-16 files (recognized by their byte order mark) are rejected
+   };
+
+   struct ValidatedText
+   {
+      std::string text; // Always valid UTF-8
+      TextUtils::TextEncoding sourceEncoding = TextUtils::TextEncoding::UTF8;
+      bool hadByteOrderMark = false;
+   };
+
+   // Reads a text file and checks that it's valid UTF-8, validating each chunk as soon as it has been read (std::nullopt if it can't be read or isn't valid)
+   std::optional<ValidatedText> readValidatedTextFile(const std::filesystem::path& path, const TextReadOptions& options = {});
+
+   static constexpr std::size_t kDefaultBatchQueueDepth = 64;
+
+   // Reads many files concurrently (via io_uring where available, otherwise a thread pool), with results matching readBinaryFile()
+   // The function is called on the calling thread, in completion order
+   void readFilesBatch(std::span<const std::filesystem::path> paths, const OSUtils::AsyncReadFunction& function, std::size_t queueDepth = kDefaultBatchQueueDepth);
+   std::vector<std::optional<std::vector<uint8_t>>> readFilesBatch(std::span<const std::filesystem::path> paths, std::size_t queueDepth = kDefaultBatchQueueDepth);
+
+   bool writeTextFile(const std::filesystem::path& path, std::string_view data, const WriteOptions& options = {});
+   bool writeBinaryFile(const std::filesystem::path& path, const std::vector<uint8_t>& data, const WriteOptions& options = {});
+   bool writeBinaryFile(const std::filesystem::path& path, std::span<const uint8_t> data, const WriteOptions& options = {});
+
+   // Writes the fragments back to back, without first gathering them into a single buffer
+   bool writeBinaryFile(const std::filesystem::path& path, std::span<const std::span<const uint8_t>> fragments, const WriteOptions& options = {});
+
+   // Reads a file a chunk at a time, so memory use stays bounded regardless of the file's size
+   class FileReader
+   {
+   public:
+      using ChunkFunction = std::function<bool(std::span<const uint8_t> /* chunk */)>;
+
+      static constexpr std::size_t kDefaultChunkSize = 1024 * 1024;
+
+      explicit FileReader(const std::filesystem::path& path, std::size_t chunkSize = kDefaultChunkSize);
+      FileReader(const std::filesystem::path& path, std::span<uint8_t> chunkBuffer); // The buffer must outlive the reader
+
+      bool isOpen() const
+      {
+         return file.has_value();
+      }
+
+      // Reads the next chunk into the reader's buffer (valid until the next read), an empty chunk marks the end of the file
+      std::optional<std::span<const uint8_t>> readChunk();
+
+      // Reads the next chunk directly into the given buffer, returning the number of bytes read (0 at the end of the file)
+      std::optional<std::size_t> read(std::span<uint8_t> destination);
+
+      // Calls the function with each remaining chunk until the end of the file, or until the function returns false
+      bool forEachChunk(const ChunkFunction& function);
+
+   private:
+      std::optional<OSUtils::File> file;
+      std::vector<uint8_t> ownedBuffer;
+      std::span<uint8_t> buffer;
+   };
+
+   // Writes a file a chunk at a time, flushing whenever the buffer fills up
+   class FileWriter
+   {
+   public:
+      static constexpr std::size_t kDefaultBufferSize = 1024 * 1024;
+
+      explicit FileWriter(const std::filesystem::path& path, const WriteOptions& options = {}, std::size_t bufferSize = kDefaultBufferSize);
+      FileWriter(const std::filesystem::path& path, std::span<uint8_t> writeBuffer, const WriteOptions& options = {}); // The buffer must outlive the writer
+      FileWriter(const FileWriter& other) = delete;
+      FileWriter(FileWriter&& other);
+      ~FileWriter();
+
+      FileWriter& operator=(const FileWriter& other) = delete;
+      FileWriter& operator=(FileWriter&& other);
 
+      bool isOpen() const
+      {
+         return file.has_value();
+      }
+
+      bool write(std::span<const uint8_t> data);
+      bool flush();
+
+      // Flushes any buffered data, and for atomic / durable writes, publishes the file (only if every write succeeded)
+      bool close();
+
+   private:
+      std::filesystem::path path;
+      WriteOptions options;
+
+      std::optional<OSUtils::File> file;
+      std::vector<uint8_t> ownedBuffer;
+      std::span<uint8_t> buffer;
+      std::size_t bufferedSize = 0;
+      bool failed = false;
+   };
+
+   struct DirectoryEntry
+   {
+      std::filesystem::path path;
+      OSUtils::DirectoryEntryType type = OSUtils::DirectoryEntryType::Other;
+   };
+
+   struct EnumerateDirectoryOptions
+   {
+      bool recursive = true;
+      std::size_t numThreads = 0; // 0 to use the hardware concurrency
+
+      // Called concurrently from the worker threads, rejected entries are left out of the results (and rejected directories aren't descended into)
+      std::function<bool(const DirectoryEntry&)> filter;
+   };
+
+   // Lists everything under a directory (in no particular order), fanning subdirectories out across a pool of threads
+   // Symlinks aren't followed, and subdirectories that can't be read are skipped
+   std::optional<std::vector<DirectoryEntry>> enumerateDirectory(const std::filesystem::path& directory, const EnumerateDirectoryOptions& options = {});
+
+   enum class CopyMethod
+   {
+      Clone, // The copy shares storage with the source until either is modified
+      Kernel, // The data was copied by the kernel, without passing through user space
+      Buffered // The data was copied through a fixed size buffer
+   };
+
+   // Copies a file's contents and permissions using the cheapest method available, and reports which one that was
+   // Fails if the destination is the source (or a hard link to it)
+   std::optional<CopyMethod> copyFile(const std::filesystem::path& source, const std::filesystem::path& destination, const WriteOptions& options = {});
+
+   // Remembers file hashes by file identity, size and modification time, so unchanged files don't need to be hashed again
+   class FileHashCache
+   {
+   public:
+      bool load(const std::filesystem::path& path);
+      bool save(const std::filesystem::path& path) const;
+
+      std::optional<HashUtils::Hash128> find(const OSUtils::FileInfo& info) const;
+      void store(const OSUtils::FileInfo& info, const HashUtils::Hash128& hash);
+      void clear();
+
+   private:
+      struct Key
+      {
+         uint64_t device = 0;
+         uint64_t inode = 0;
+
+         bool operator==(const Key& other) const = default;
+      };
+
+      struct KeyHasher
+      {
+         std::size_t operator()(const Key& key) const
+         {
+            return std::hash<uint64_t>{}(key.device * 0x9E3779B185EBCA87 ^ key.inode);
+         }
+      };
+
+      struct Entry
+      {
+         uint64_t size = 0;
+         int64_t modificationTime = 0;
+         HashUtils::Hash128 hash;
+      };
+
+      mutable std::mutex mutex;
+      std::unordered_map<Key, Entry, KeyHasher> entries;
+   };
+
+   // Hashes a file's contents (through a memory mapping where possible), skipping the work entirely if the cache has an up to date entry
+   std::optional<HashUtils::Hash128> hashFile(const std::filesystem::path& path, FileHashCache* cache = nullptr);
+
+   // Searched for once and then cached (safe to call from any thread)
    std::optional<std::filesystem::path> findProjectDirectory();
 
+   // Also refreshes the paths cached by OSUtils (which the project directory is based on)
+   void refreshCachedPaths();
+
    std::optional<std::filesystem::path> getAbsolutePath(const std::filesystem::path& base, const std::filesystem::path& relativePath);
    std::optional<std::filesystem::path> getAbsoluteKnownPath(OSUtils::KnownDirectory knownDirectory, const std::filesystem::path& relativePath);
 
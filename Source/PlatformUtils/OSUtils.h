@@ -1,10 +1,15 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <functional>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -23,32 +28,403 @@ namespace OSUtils
       CommonApplicationData,
    };
 
+   // Both are looked up once and then cached (safe to call from any thread)
    std::optional<std::filesystem::path> getExecutablePath();
    std::optional<std::filesystem::path> getKnownDirectoryPath(KnownDirectory knownDirectory);
+
+   // Makes the next calls look the paths up again (e.g. after changing the environment variables they're based on)
+   void refreshCachedPaths();
+
    bool setWorkingDirectoryToExecutableDirectory();
 
+   struct CPUFeatures
+   {
+      bool sse2 = false;
+      bool ssse3 = false;
+      bool avx2 = false;
+   };
+
+   const CPUFeatures& getCPUFeatures();
+
+   struct FileInfo
+   {
+      uint64_t device = 0;
+      uint64_t inode = 0; // Together with the device, uniquely identifies the file
+      uint64_t size = 0;
+      int64_t modificationTime = 0; // Nanoseconds since the Unix epoch
+
+      bool operator==(const FileInfo& other) const = default;
+   };
+
+   std::optional<FileInfo> getFileInfo(const std::filesystem::path& path);
+
+   enum class FileAccessPattern
+   {
+      Normal,
+      Sequential,
+      Random
+   };
+
+   struct MapFileOptions
+   {
+      FileAccessPattern accessPattern = FileAccessPattern::Normal;
+      bool prefetch = false; // Fault in the whole file up front
+   };
+
+   // Read-only view of a file's contents, mapped directly into the address space
+   class MappedFile
+   {
+   public:
+      MappedFile() = default;
+      MappedFile(const MappedFile& other) = delete;
+      MappedFile(MappedFile&& other);
+      ~MappedFile();
+
+      MappedFile& operator=(const MappedFile& other) = delete;
+      MappedFile& operator=(MappedFile&& other);
+
+      std::span<const uint8_t> getData() const
+      {
+         return std::span<const uint8_t>(data, size);
+      }
+
+      std::size_t getSize() const
+      {
+         return size;
+      }
+
+   private:
+      friend std::optional<MappedFile> mapFile(const std::filesystem::path& path, const MapFileOptions& options);
+
+      MappedFile(const uint8_t* mappedData, std::size_t mappedSize);
+
+      void unmap();
+
+      const uint8_t* data = nullptr;
+      std::size_t size = 0;
+   };
+
+   // Empty files can't be mapped, and will result in std::nullopt
+   std::optional<MappedFile> mapFile(const std::filesystem::path& path, const MapFileOptions& options = {});
+
+   enum class FileOpenMode
+   {
+      Read,
+      Write, // Creates the file if necessary, and truncates it
+      Append // Creates the file if necessary, all writes go to the end
+   };
+
+   // Unbuffered handle to an open file (a file descriptor on POSIX, a HANDLE on Windows)
+   class File
+   {
+   public:
+      using NativeHandle = std::intptr_t;
+
+      static constexpr NativeHandle kInvalidHandle = -1;
+
+      File() = default;
+      File(const File& other) = delete;
+      File(File&& other);
+      ~File();
+
+      File& operator=(const File& other) = delete;
+      File& operator=(File&& other);
+
+      bool isOpen() const
+      {
+         return handle != kInvalidHandle;
+      }
+
+      NativeHandle getNativeHandle() const
+      {
+         return handle;
+      }
+
+      // Only regular files have a size
+      std::optional<uint64_t> getSize() const;
+
+      // Fills as much of the buffer as possible, only stopping early at the end of the file
+      std::optional<std::size_t> read(std::span<uint8_t> buffer);
+
+      // Writes all of the data at the current position
+      bool write(std::span<const uint8_t> data);
+
+      // Writes all of the fragments back to back at the current position (using a single system call where possible)
+      bool write(std::span<const std::span<const uint8_t>> fragments);
+
+      // Writes all of the data at the given offset, without moving the current position
+      bool writeAt(uint64_t offset, std::span<const uint8_t> data);
+
+      // Flushes the file's contents all the way to the storage device
+      bool sync();
+
+      // Sets the file's permission bits (does nothing on Windows, where access comes from ACLs inherited from the directory)
+      bool setPermissions(std::filesystem::perms permissions);
+
+      void close();
+
+   private:
+      friend std::optional<File> openFile(const std::filesystem::path& path, FileOpenMode mode, FileAccessPattern accessPattern);
+      friend std::optional<File> createTemporaryFile(const std::filesystem::path& directory);
+      friend bool commitTemporaryFile(File& file, const std::filesystem::path& path);
+
+      explicit File(NativeHandle nativeHandle, std::filesystem::path temporaryFilePath = {});
+
+      NativeHandle handle = kInvalidHandle;
+      std::filesystem::path temporaryPath; // Named temporary files are removed on close unless committed
+   };
+
+   std::optional<File> openFile(const std::filesystem::path& path, FileOpenMode mode, FileAccessPattern accessPattern = FileAccessPattern::Normal);
+
+   // Creates a writable file in the given directory that won't be visible at any meaningful path until it is committed
+   std::optional<File> createTemporaryFile(const std::filesystem::path& directory);
+
+   // Atomically publishes a file from createTemporaryFile() at the given path (which must be in the same directory), replacing anything already there
+   bool commitTemporaryFile(File& file, const std::filesystem::path& path);
+
+   // Flushes a directory's entries (e.g. after creating or renaming a file within it) to the storage device
+   bool syncDirectory(const std::filesystem::path& directory);
+
+   enum class DirectoryEntryType
+   {
+      File,
+      Directory,
+      Symlink,
+      Other
+   };
+
+   // Names are passed in the native path encoding, so they can be appended to a path without conversion
+   using DirectoryListFunction = std::function<void(std::basic_string_view<std::filesystem::path::value_type> /* name */, DirectoryEntryType /* type */)>;
+
+   // Lists a single directory's entries (excluding "." and ".."), using the types reported by the directory itself to avoid stat-ing each entry
+   // Symlinks are reported as such, and not followed
+   bool listDirectory(const std::filesystem::path& directory, const DirectoryListFunction& function);
+
+   // Makes the destination share the source's storage (copy-on-write), if the filesystem supports it
+   bool cloneFileContents(const File& source, const File& destination);
+
+   // Copies the first size bytes of the source to the destination without passing them through user space, if the platform supports it
+   bool copyFileContents(const File& source, const File& destination, uint64_t size);
+
+   using AsyncReadFunction = std::function<void(std::size_t /* index */, std::optional<std::vector<uint8_t>> /* data */)>;
+
+   // Reads whole files with up to queueDepth operations in flight, calling the function (on the calling thread) as each one completes
+   // Files that report a size of zero complete with empty data
+   // Returns false without reading anything if the platform has no suitable asynchronous I/O interface (currently io_uring on Linux)
+   bool readFilesAsync(std::span<const std::filesystem::path> paths, std::size_t queueDepth, const AsyncReadFunction& function);
+
+   enum class ProcessLaunchMethod
+   {
+      Spawn, // posix_spawn, which doesn't copy the parent's address space, so it doesn't get slower as the parent grows
+      Fork // fork + execve
+   };
+
+   // A process environment, prepared once in the native format (an envp array on POSIX, a Unicode block for CreateProcessW on Windows) and shared by every launch that uses it
+   // Immutable, so copies are cheap and can be used from any thread
+   class EnvironmentBlock
+   {
+   public:
+      // Starts from the current environment (if inherited), with the overrides taking precedence
+      explicit EnvironmentBlock(const std::unordered_map<std::string, std::string>& overrides = {}, bool inheritEnvironment = true);
+
+      std::size_t getNumVariables() const;
+
+      const void* getNativeBlock() const;
+
+   private:
+      class Impl;
+      std::shared_ptr<const Impl> impl;
+   };
+
+   using ProcessOutputFunction = std::function<void(std::string_view /* data */)>;
+
+   // Fills the buffer with the next part of the input, returning how much of it was filled (0 once there's nothing left)
+   using ProcessInputFunction = std::function<std::size_t(std::span<char> /* buffer */)>;
+
    struct ProcessStartInfo
    {
+      // Bare names (without a directory) are looked up on PATH first, so they run what's found there even if the working directory has a file with the same name (use "./name" to run that one)
       std::filesystem::path path;
       std::vector<std::string> args;
       std::unordered_map<std::string, std::string> env;
+      std::optional<EnvironmentBlock> environment; // Used instead of env and inheritEnvironment if set (saves rebuilding the same environment for each launch)
 
       bool inheritEnvironment = true;
       bool waitForExit = true;
       bool readOutput = false;
+
+      // Output is read while the process runs (so it never blocks on a full pipe), and passed to these chunk by chunk if they're set (never concurrently, but not necessarily on the calling thread)
+      // Otherwise, it's collected in ProcessExitInfo, keeping at most maxOutputSize bytes of each stream
+      ProcessOutputFunction stdOutFunction;
+      ProcessOutputFunction stdErrFunction;
+      std::optional<std::size_t> maxOutputSize;
+
+      // stdin comes from the first of these that's set (otherwise it's the same as ours)
+      // Functions and data are written while the process runs (only when waiting for it to exit), files are given to it directly
+      ProcessInputFunction stdInFunction;
+      std::optional<std::string> stdInData;
+      std::filesystem::path stdInPath;
+
+      // Once this much time has passed (only when waiting for it to exit), the process is asked to terminate, then killed if it's still running after the grace period
+      // Everything it started is terminated along with it: on POSIX it gets its own process group (SIGTERM, then SIGKILL), on Windows its own job object (terminated right away, there's no gentler way)
+      std::optional<std::chrono::milliseconds> timeout;
+      std::chrono::milliseconds killGracePeriod = std::chrono::seconds(2);
+
+      ProcessLaunchMethod launchMethod = ProcessLaunchMethod::Spawn; // Ignored on Windows
    };
 
    struct ProcessExitInfo
    {
-      int exitCode = 0;
+      int exitCode = 0; // 128 + the signal number if it was terminated by a signal (like shells report it)
+      std::optional<int> terminationSignal; // POSIX only
+      bool timedOut = false; // Still running when the timeout passed (anything it left running is terminated either way)
+
+      // Wall time is from launching it until it exited (or was found to have), peak resident size is in bytes
+      // On POSIX, CPU times include any children it waited for
+      std::chrono::microseconds wallTime = std::chrono::microseconds(0);
+      std::chrono::microseconds userTime = std::chrono::microseconds(0);
+      std::chrono::microseconds systemTime = std::chrono::microseconds(0);
+      uint64_t peakResidentSize = 0;
 
       std::string stdOut;
       std::string stdErr;
+      bool outputTruncated = false; // Output beyond maxOutputSize was dropped
    };
 
    std::unordered_map<std::string, std::string> getEnvironment();
    std::optional<ProcessExitInfo> executeProcess(ProcessStartInfo startInfo);
 
+   // Runs the processes like a shell pipeline (a | b | c), each one's stdout connected directly to the next one's stdin (so the data between them never passes through this process)
+   // stdin is only taken from the first one's ProcessStartInfo, and stdout is only read from the last one, but any of them can have their stderr read (waitForExit is always treated as true)
+   // Returns each process's result, in order
+   std::vector<std::optional<ProcessExitInfo>> executePipeline(std::vector<ProcessStartInfo> startInfos);
+
+   // A process started by startProcess(), to be waited for later
+   // Destroying the handle doesn't stop the process (it's reaped if it has already exited)
+   class ProcessHandle
+   {
+   public:
+      using ID = int64_t;
+      using NativeHandle = std::intptr_t;
+
+      static constexpr ID kInvalidIdentifier = -1;
+      static constexpr NativeHandle kInvalidHandle = -1;
+
+      ProcessHandle() = default;
+      ProcessHandle(const ProcessHandle& other) = delete;
+      ProcessHandle(ProcessHandle&& other);
+      ~ProcessHandle();
+
+      ProcessHandle& operator=(const ProcessHandle& other) = delete;
+      ProcessHandle& operator=(ProcessHandle&& other);
+
+      bool isValid() const
+      {
+         return id != kInvalidIdentifier;
+      }
+
+      ID getId() const
+      {
+         return id;
+      }
+
+      // Becomes readable (a pidfd on Linux) or signaled (Windows) when the process exits, kInvalidHandle if there's no such thing (macOS, Linux before 5.3)
+      NativeHandle getNativeHandle() const
+      {
+         return handle;
+      }
+
+      bool hasExited() const
+      {
+         return exited;
+      }
+
+      // Set once it has been reaped, following the same convention as ProcessExitInfo (128 + the signal number if it was terminated by a signal)
+      // Unset if it was reaped by someone else, since its status is gone by then
+      std::optional<int> getExitCode() const
+      {
+         return exitInfo ? std::optional<int>(exitInfo->exitCode) : std::nullopt;
+      }
+
+      // Everything executeProcess() would have reported about it, except its output (which isn't captured)
+      const std::optional<ProcessExitInfo>& getExitInfo() const
+      {
+         return exitInfo;
+      }
+
+      // Reaps the process if it has exited, without blocking, returning whether it has
+      bool tryWait();
+
+      // Blocks until the process exits or the timeout passes, returning whether it has exited
+      bool wait(std::optional<std::chrono::milliseconds> timeout = std::nullopt);
+
+      // Forcefully stops the process (it still has to be waited for)
+      bool kill();
+
+   private:
+      friend std::optional<ProcessHandle> startProcess(ProcessStartInfo startInfo);
+
+      ProcessHandle(ID processId, NativeHandle nativeHandle);
+
+      void release();
+
+      ID id = kInvalidIdentifier;
+      NativeHandle handle = kInvalidHandle;
+      std::chrono::steady_clock::time_point launchTime; // For the wall time, where the OS doesn't track it (POSIX)
+      std::optional<ProcessExitInfo> exitInfo;
+      bool exited = false;
+   };
+
+   // Starts a process without waiting for it (waitForExit and readOutput are ignored, its output isn't captured, and its stdin can only come from stdInPath)
+   std::optional<ProcessHandle> startProcess(ProcessStartInfo startInfo);
+
+   // Waits for any number of processes at once, on a single thread (epoll on Linux, kqueue on macOS, WaitForMultipleObjects on Windows)
+   class ProcessReactor
+   {
+   public:
+      using ExitFunction = std::function<void(ProcessHandle& /* process */)>;
+
+      ProcessReactor();
+      ~ProcessReactor();
+
+      // Takes over the process, the function is called from wait() once it has exited (and been reaped)
+      void add(ProcessHandle process, ExitFunction exitFunction);
+
+      // Blocks until at least one process exits or the timeout passes (zero only checks), returning how many exited
+      // Functions may add more processes
+      std::size_t wait(std::optional<std::chrono::milliseconds> timeout = std::nullopt);
+
+      std::size_t getNumProcesses() const;
+
+   private:
+      class Impl;
+      std::unique_ptr<Impl> impl;
+   };
+
+   // Launches processes from a small helper process (forked when this is created) rather than from this one
+   // Launching from a large process costs more the larger it is (address space and descriptor table setup), which adds up over many launches
+   // Create it early, before starting any threads and while this process is still small (the server keeps whatever was open at that point, apart from close-on-exec descriptors)
+   // The child's pipes are created here and passed to the server over a Unix socket, so its output streams straight back to us, followed by its exit status once it has exited
+   // Windows has no fork to avoid, so processes are always launched directly there (as they are if the server couldn't be started)
+   class ForkServer
+   {
+   public:
+      ForkServer();
+      ForkServer(const ForkServer& other) = delete;
+      ~ForkServer(); // Stops the server, processes it launched keep running
+
+      ForkServer& operator=(const ForkServer& other) = delete;
+
+      bool isRunning() const;
+
+      // Same as OSUtils::executeProcess() (and can be called from any number of threads at once), timeouts are enforced by the server
+      std::optional<ProcessExitInfo> executeProcess(ProcessStartInfo startInfo);
+
+   private:
+      class Impl;
+      std::unique_ptr<Impl> impl;
+   };
+
    enum class DirectoryWatchEvent
    {
       Create,
@@ -70,6 +446,9 @@ namespace OSUtils
 
       void update();
 
+      // Whether update() has anything to deliver, without delivering it (so it's safe to call from several threads at once, as long as nothing else is called meanwhile)
+      bool hasPendingEvents() const;
+
       ID addWatch(const std::filesystem::path& directory, bool recursive, NotifyFunction notifyFunction);
       void removeWatch(ID id);
 
@@ -1,7 +1,73 @@
 #include "PlatformUtils/OSUtils.h"
 
+#include "PlatformUtils/CachedValue.h"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  include <intrin.h>
+#  include <immintrin.h>
+#endif
+
 namespace OSUtils
 {
+   // Implemented per platform
+   std::optional<std::filesystem::path> computeExecutablePath();
+   std::optional<std::filesystem::path> computeKnownDirectoryPath(KnownDirectory knownDirectory);
+
+   namespace
+   {
+      const std::size_t kNumKnownDirectories = static_cast<std::size_t>(KnownDirectory::CommonApplicationData) + 1;
+
+      CachedValue<std::optional<std::filesystem::path>> cachedExecutablePath;
+      std::array<CachedValue<std::optional<std::filesystem::path>>, kNumKnownDirectories> cachedKnownDirectoryPaths;
+   }
+
+   std::optional<std::filesystem::path> getExecutablePath()
+   {
+      return cachedExecutablePath.get([]() { return computeExecutablePath(); });
+   }
+
+   std::optional<std::filesystem::path> getKnownDirectoryPath(KnownDirectory knownDirectory)
+   {
+      std::size_t index = static_cast<std::size_t>(knownDirectory);
+      if (index >= kNumKnownDirectories)
+      {
+         return std::nullopt;
+      }
+
+      return cachedKnownDirectoryPaths[index].get([knownDirectory]() { return computeKnownDirectoryPath(knownDirectory); });
+   }
+
+   void refreshCachedPaths()
+   {
+      cachedExecutablePath.refresh();
+      for (CachedValue<std::optional<std::filesystem::path>>& cachedKnownDirectoryPath : cachedKnownDirectoryPaths)
+      {
+         cachedKnownDirectoryPath.refresh();
+      }
+   }
+
+   void appendProcessOutput(std::string& output, std::string_view data, const ProcessOutputFunction& function, std::optional<std::size_t> maxOutputSize, bool& truncated)
+   {
+      if (function)
+      {
+         function(data);
+         return;
+      }
+
+      std::size_t numBytesToKeep = data.size();
+      if (maxOutputSize)
+      {
+         numBytesToKeep = std::min(numBytesToKeep, *maxOutputSize - std::min(*maxOutputSize, output.size()));
+      }
+
+      output.append(data.data(), numBytesToKeep);
+      truncated |= numBytesToKeep < data.size();
+   }
+
    bool setWorkingDirectoryToExecutableDirectory()
    {
       if (std::optional<std::filesystem::path> executablePath = getExecutablePath())
@@ -14,4 +80,134 @@ namespace OSUtils
 
       return false;
    }
+
+   namespace
+   {
+      CPUFeatures detectCPUFeatures()
+      {
+         CPUFeatures features;
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+         __builtin_cpu_init();
+         features.sse2 = __builtin_cpu_supports("sse2");
+         features.ssse3 = __builtin_cpu_supports("ssse3");
+         features.avx2 = __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+         int info[4]{};
+         __cpuid(info, 1);
+         features.sse2 = (info[3] & (1 << 26)) != 0;
+         features.ssse3 = (info[2] & (1 << 9)) != 0;
+
+         // AVX2 also requires the OS to save the YMM registers on context switches
+         bool osSavesYMM = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+         __cpuidex(info, 7, 0);
+         features.avx2 = osSavesYMM && (info[1] & (1 << 5)) != 0;
+#endif
+
+         return features;
+      }
+   }
+
+   const CPUFeatures& getCPUFeatures()
+   {
+      static const CPUFeatures kFeatures = detectCPUFeatures();
+      return kFeatures;
+   }
+
+   MappedFile::MappedFile(const uint8_t* mappedData, std::size_t mappedSize)
+      : data(mappedData)
+      , size(mappedSize)
+   {
+   }
+
+   MappedFile::MappedFile(MappedFile&& other)
+      : data(std::exchange(other.data, nullptr))
+      , size(std::exchange(other.size, 0))
+   {
+   }
+
+   MappedFile::~MappedFile()
+   {
+      unmap();
+   }
+
+   MappedFile& MappedFile::operator=(MappedFile&& other)
+   {
+      if (this != &other)
+      {
+         unmap();
+
+         data = std::exchange(other.data, nullptr);
+         size = std::exchange(other.size, 0);
+      }
+
+      return *this;
+   }
+
+   File::File(NativeHandle nativeHandle, std::filesystem::path temporaryFilePath)
+      : handle(nativeHandle)
+      , temporaryPath(std::move(temporaryFilePath))
+   {
+   }
+
+   File::File(File&& other)
+      : handle(std::exchange(other.handle, kInvalidHandle))
+      , temporaryPath(std::exchange(other.temporaryPath, {}))
+   {
+   }
+
+   File::~File()
+   {
+      close();
+   }
+
+   File& File::operator=(File&& other)
+   {
+      if (this != &other)
+      {
+         close();
+
+         handle = std::exchange(other.handle, kInvalidHandle);
+         temporaryPath = std::exchange(other.temporaryPath, {});
+      }
+
+      return *this;
+   }
+
+   ProcessHandle::ProcessHandle(ID processId, NativeHandle nativeHandle)
+      : id(processId)
+      , handle(nativeHandle)
+      , launchTime(std::chrono::steady_clock::now())
+   {
+   }
+
+   ProcessHandle::ProcessHandle(ProcessHandle&& other)
+      : id(std::exchange(other.id, kInvalidIdentifier))
+      , handle(std::exchange(other.handle, kInvalidHandle))
+      , launchTime(other.launchTime)
+      , exitInfo(std::exchange(other.exitInfo, std::nullopt))
+      , exited(std::exchange(other.exited, false))
+   {
+   }
+
+   ProcessHandle::~ProcessHandle()
+   {
+      release();
+   }
+
+   ProcessHandle& ProcessHandle::operator=(ProcessHandle&& other)
+   {
+      if (this != &other)
+      {
+         release();
+
+         id = std::exchange(other.id, kInvalidIdentifier);
+         handle = std::exchange(other.handle, kInvalidHandle);
+         launchTime = other.launchTime;
+         exitInfo = std::exchange(other.exitInfo, std::nullopt);
+         exited = std::exchange(other.exited, false);
+      }
+
+      return *this;
+   }
 }
@@ -1,20 +1,38 @@
 #include "PlatformUtils/OSUtils.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <linux/io_uring.h>
 #include <linux/limits.h>
 #include <poll.h>
 #include <pwd.h>
+#include <sys/epoll.h>
 #include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/param.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 namespace OSUtils
 {
-   std::optional<std::filesystem::path> getExecutablePath()
+   std::optional<std::filesystem::path> computeExecutablePath()
    {
       char path[PATH_MAX + 1];
       ssize_t numBytes = readlink("/proc/self/exe", path, PATH_MAX);
@@ -29,6 +47,16 @@ namespace OSUtils
 
    namespace
    {
+      // Not exposed by glibc's headers
+      struct linux_dirent64
+      {
+         ino64_t d_ino;
+         off64_t d_off;
+         unsigned short d_reclen;
+         unsigned char d_type;
+         char d_name[];
+      };
+
       const char* getHomeDir()
       {
          // First, check the HOME environment variable
@@ -48,7 +76,7 @@ namespace OSUtils
       }
    }
 
-   std::optional<std::filesystem::path> getKnownDirectoryPath(KnownDirectory knownDirectory)
+   std::optional<std::filesystem::path> computeKnownDirectoryPath(KnownDirectory knownDirectory)
    {
       if (knownDirectory == KnownDirectory::UserApplications)
       {
@@ -85,6 +113,560 @@ namespace OSUtils
       }
    }
 
+   bool listDirectory(const std::filesystem::path& directory, const DirectoryListFunction& function)
+   {
+      int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (fd < 0)
+      {
+         return false;
+      }
+
+      // Read entries straight from the kernel, rather than through readdir() (which allocates, and would read in smaller batches)
+      alignas(linux_dirent64) std::array<uint8_t, 64 * 1024> buffer;
+      while (true)
+      {
+         long numBytes = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+         if (numBytes < 0 && errno == EINTR)
+         {
+            continue;
+         }
+
+         if (numBytes <= 0)
+         {
+            close(fd);
+            return numBytes == 0;
+         }
+
+         for (long offset = 0; offset < numBytes;)
+         {
+            const linux_dirent64* entry = reinterpret_cast<const linux_dirent64*>(buffer.data() + offset);
+            offset += entry->d_reclen;
+
+            std::string_view name = entry->d_name;
+            if (name == "." || name == "..")
+            {
+               continue;
+            }
+
+            unsigned char type = entry->d_type;
+            if (type == DT_UNKNOWN)
+            {
+               // Some filesystems don't report types
+               struct stat entryStat{};
+               if (fstatat(fd, entry->d_name, &entryStat, AT_SYMLINK_NOFOLLOW) == 0)
+               {
+                  type = IFTODT(entryStat.st_mode);
+               }
+            }
+
+            switch (type)
+            {
+            case DT_REG:
+               function(name, DirectoryEntryType::File);
+               break;
+            case DT_DIR:
+               function(name, DirectoryEntryType::Directory);
+               break;
+            case DT_LNK:
+               function(name, DirectoryEntryType::Symlink);
+               break;
+            default:
+               function(name, DirectoryEntryType::Other);
+               break;
+            }
+         }
+      }
+   }
+
+   bool cloneFileContents(const File& source, const File& destination)
+   {
+      return ioctl(static_cast<int>(destination.getNativeHandle()), FICLONE, static_cast<int>(source.getNativeHandle())) == 0;
+   }
+
+   bool copyFileContents(const File& source, const File& destination, uint64_t size)
+   {
+      int sourceFd = static_cast<int>(source.getNativeHandle());
+      int destinationFd = static_cast<int>(destination.getNativeHandle());
+
+      // Prefer copy_file_range(), which can use server-side copies on network filesystems
+      loff_t sourceOffset = 0;
+      loff_t destinationOffset = 0;
+      while (static_cast<uint64_t>(sourceOffset) < size)
+      {
+         ssize_t result = copy_file_range(sourceFd, &sourceOffset, destinationFd, &destinationOffset, size - sourceOffset, 0);
+         if (result < 0 && errno == EINTR)
+         {
+            continue;
+         }
+
+         if (result <= 0)
+         {
+            break;
+         }
+      }
+
+      if (static_cast<uint64_t>(sourceOffset) >= size)
+      {
+         return true;
+      }
+
+      // Not supported (e.g. across filesystems on older kernels), fall back to sendfile(), which can write to any file
+      off_t offset = 0;
+      if (lseek(destinationFd, 0, SEEK_SET) != 0)
+      {
+         return false;
+      }
+
+      while (static_cast<uint64_t>(offset) < size)
+      {
+         ssize_t result = sendfile(destinationFd, sourceFd, &offset, size - offset);
+         if (result < 0 && errno == EINTR)
+         {
+            continue;
+         }
+
+         if (result <= 0)
+         {
+            return false;
+         }
+      }
+
+      return true;
+   }
+
+   namespace
+   {
+      // Minimal io_uring wrapper (using the raw system calls, to avoid depending on liburing)
+      class IORing
+      {
+      public:
+         IORing() = default;
+         IORing(const IORing& other) = delete;
+
+         ~IORing()
+         {
+            if (submissions)
+            {
+               munmap(submissions, submissionsSize);
+            }
+
+            if (completionRing && completionRing != submissionRing)
+            {
+               munmap(completionRing, completionRingSize);
+            }
+
+            if (submissionRing)
+            {
+               munmap(submissionRing, submissionRingSize);
+            }
+
+            if (ringFd >= 0)
+            {
+               close(ringFd);
+            }
+         }
+
+         IORing& operator=(const IORing& other) = delete;
+
+         bool initialize(unsigned int numEntries)
+         {
+            io_uring_params params{};
+            ringFd = static_cast<int>(syscall(__NR_io_uring_setup, numEntries, &params));
+            if (ringFd < 0)
+            {
+               return false;
+            }
+
+            submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+            completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (singleMap)
+            {
+               submissionRingSize = completionRingSize = std::max(submissionRingSize, completionRingSize);
+            }
+
+            submissionRing = mapRegion(submissionRingSize, IORING_OFF_SQ_RING);
+            completionRing = singleMap ? submissionRing : mapRegion(completionRingSize, IORING_OFF_CQ_RING);
+            submissionsSize = params.sq_entries * sizeof(io_uring_sqe);
+            submissions = static_cast<io_uring_sqe*>(mapRegion(submissionsSize, IORING_OFF_SQES));
+            if (!submissionRing || !completionRing || !submissions)
+            {
+               return false;
+            }
+
+            uint8_t* sqBase = static_cast<uint8_t*>(submissionRing);
+            sqHead = reinterpret_cast<unsigned int*>(sqBase + params.sq_off.head);
+            sqTail = reinterpret_cast<unsigned int*>(sqBase + params.sq_off.tail);
+            sqMask = *reinterpret_cast<unsigned int*>(sqBase + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned int*>(sqBase + params.sq_off.array);
+            sqEntries = params.sq_entries;
+
+            uint8_t* cqBase = static_cast<uint8_t*>(completionRing);
+            cqHead = reinterpret_cast<unsigned int*>(cqBase + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned int*>(cqBase + params.cq_off.tail);
+            cqMask = *reinterpret_cast<unsigned int*>(cqBase + params.cq_off.ring_mask);
+            completions = reinterpret_cast<io_uring_cqe*>(cqBase + params.cq_off.cqes);
+
+            localTail = *sqTail;
+
+            return true;
+         }
+
+         bool supports(std::initializer_list<uint8_t> opcodes) const
+         {
+            static const unsigned int kNumProbeOps = 256;
+
+            std::vector<uint8_t> probeBuffer(sizeof(io_uring_probe) + kNumProbeOps * sizeof(io_uring_probe_op));
+            io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(probeBuffer.data());
+            if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, kNumProbeOps) < 0)
+            {
+               return false;
+            }
+
+            for (uint8_t opcode : opcodes)
+            {
+               if (opcode > probe->last_op || !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED))
+               {
+                  return false;
+               }
+            }
+
+            return true;
+         }
+
+         io_uring_sqe* getSubmission()
+         {
+            unsigned int head = std::atomic_ref<unsigned int>(*sqHead).load(std::memory_order_acquire);
+            if (localTail - head >= sqEntries)
+            {
+               return nullptr;
+            }
+
+            unsigned int index = localTail & sqMask;
+            ++localTail;
+
+            io_uring_sqe* submission = &submissions[index];
+            std::memset(submission, 0, sizeof(*submission));
+            sqArray[index] = index;
+
+            return submission;
+         }
+
+         bool submitAndWait(unsigned int numCompletionsToWaitFor)
+         {
+            std::atomic_ref<unsigned int>(*sqTail).store(localTail, std::memory_order_release);
+
+            unsigned int numToSubmit = localTail - std::atomic_ref<unsigned int>(*sqHead).load(std::memory_order_acquire);
+            unsigned int flags = numCompletionsToWaitFor > 0 ? IORING_ENTER_GETEVENTS : 0;
+            while (syscall(__NR_io_uring_enter, ringFd, numToSubmit, numCompletionsToWaitFor, flags, nullptr, 0) < 0)
+            {
+               if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+               {
+                  return false;
+               }
+
+               // EAGAIN / EBUSY mean the kernel wants completions to be reaped first, so stop waiting and let the caller do that
+               if (errno != EINTR)
+               {
+                  break;
+               }
+            }
+
+            return true;
+         }
+
+         template<typename Function>
+         void forEachCompletion(Function&& function)
+         {
+            unsigned int head = *cqHead;
+            unsigned int tail = std::atomic_ref<unsigned int>(*cqTail).load(std::memory_order_acquire);
+
+            while (head != tail)
+            {
+               io_uring_cqe completion = completions[head & cqMask];
+               ++head;
+
+               // Release the entry before handling it, so the handler can queue more work
+               std::atomic_ref<unsigned int>(*cqHead).store(head, std::memory_order_release);
+               function(completion);
+            }
+         }
+
+      private:
+         void* mapRegion(std::size_t size, off_t offset)
+         {
+            void* region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, offset);
+            return region == MAP_FAILED ? nullptr : region;
+         }
+
+         int ringFd = -1;
+
+         void* submissionRing = nullptr;
+         std::size_t submissionRingSize = 0;
+         void* completionRing = nullptr;
+         std::size_t completionRingSize = 0;
+         io_uring_sqe* submissions = nullptr;
+         std::size_t submissionsSize = 0;
+
+         unsigned int* sqHead = nullptr;
+         unsigned int* sqTail = nullptr;
+         unsigned int* sqArray = nullptr;
+         unsigned int sqMask = 0;
+         unsigned int sqEntries = 0;
+         unsigned int localTail = 0;
+
+         unsigned int* cqHead = nullptr;
+         unsigned int* cqTail = nullptr;
+         unsigned int cqMask = 0;
+         io_uring_cqe* completions = nullptr;
+      };
+
+      std::optional<std::vector<uint8_t>> readFileSynchronously(const std::filesystem::path& path)
+      {
+         std::optional<File> file = openFile(path, FileOpenMode::Read, FileAccessPattern::Sequential);
+         std::optional<uint64_t> size = file ? file->getSize() : std::nullopt;
+         if (!size)
+         {
+            return std::nullopt;
+         }
+
+         std::vector<uint8_t> data(*size);
+         std::optional<std::size_t> numBytesRead = file->read(data);
+         if (!numBytesRead)
+         {
+            return std::nullopt;
+         }
+
+         data.resize(*numBytesRead);
+         return data;
+      }
+   }
+
+   bool readFilesAsync(std::span<const std::filesystem::path> paths, std::size_t queueDepth, const AsyncReadFunction& function)
+   {
+      static const unsigned int kMaxQueueDepth = 4096;
+      static const uint64_t kCancelUserData = std::numeric_limits<uint64_t>::max();
+
+      std::size_t maxInFlight = std::clamp<std::size_t>(std::min(queueDepth, paths.size()), 1, kMaxQueueDepth);
+
+      struct Request
+      {
+         int fd = -1;
+         std::vector<uint8_t> data;
+         std::size_t offset = 0;
+         bool inFlight = false; // Has an operation queued or running in the kernel
+         bool finished = false;
+      };
+
+      // Declared before the ring, so that buffers outlive it
+      std::vector<Request> requests(paths.size());
+
+      IORing ring;
+      if (!ring.initialize(static_cast<unsigned int>(maxInFlight)) || !ring.supports({ IORING_OP_OPENAT, IORING_OP_READ }))
+      {
+         return false;
+      }
+      std::size_t nextIndex = 0;
+      std::size_t numInFlight = 0;
+      bool ringFailed = false;
+
+      // Leaves the request to be read synchronously
+      auto abandon = [&](std::size_t index)
+      {
+         Request& request = requests[index];
+         if (request.fd >= 0)
+         {
+            close(request.fd);
+            request.fd = -1;
+         }
+
+         request.inFlight = false;
+         --numInFlight;
+      };
+
+      auto finish = [&](std::size_t index, bool succeeded)
+      {
+         abandon(index);
+
+         Request& request = requests[index];
+         request.finished = true;
+
+         function(index, succeeded ? std::make_optional(std::move(request.data)) : std::nullopt);
+      };
+
+      auto queueOpen = [&](std::size_t index)
+      {
+         io_uring_sqe* submission = ring.getSubmission();
+         if (!submission)
+         {
+            return false;
+         }
+
+         submission->opcode = IORING_OP_OPENAT;
+         submission->fd = AT_FDCWD;
+         submission->addr = reinterpret_cast<uint64_t>(paths[index].c_str());
+         submission->open_flags = O_RDONLY | O_CLOEXEC | O_NONBLOCK; // Don't hang on FIFOs (they're rejected below anyways)
+         submission->user_data = index;
+
+         requests[index].inFlight = true;
+         return true;
+      };
+
+      auto queueRead = [&](std::size_t index)
+      {
+         io_uring_sqe* submission = ring.getSubmission();
+         while (!submission)
+         {
+            if (!ring.submitAndWait(0))
+            {
+               ringFailed = true;
+               abandon(index);
+               return;
+            }
+
+            submission = ring.getSubmission();
+         }
+
+         Request& request = requests[index];
+         submission->opcode = IORING_OP_READ;
+         submission->fd = request.fd;
+         submission->addr = reinterpret_cast<uint64_t>(request.data.data() + request.offset);
+         submission->len = static_cast<uint32_t>(std::min<std::size_t>(request.data.size() - request.offset, std::numeric_limits<int32_t>::max()));
+         submission->off = request.offset;
+         submission->user_data = index;
+      };
+
+      auto handleCompletion = [&](const io_uring_cqe& completion)
+      {
+         if (completion.user_data == kCancelUserData)
+         {
+            return;
+         }
+
+         std::size_t index = static_cast<std::size_t>(completion.user_data);
+         Request& request = requests[index];
+
+         if (ringFailed)
+         {
+            // Draining after a failure, whatever this was is read again synchronously (keeping any file it opened from leaking)
+            if (request.fd < 0 && completion.res >= 0)
+            {
+               request.fd = completion.res;
+            }
+
+            abandon(index);
+         }
+         else if (completion.res < 0)
+         {
+            finish(index, false);
+         }
+         else if (request.fd < 0)
+         {
+            // Open completed
+            request.fd = completion.res;
+
+            struct stat fileStat{};
+            if (fstat(request.fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode))
+            {
+               finish(index, false);
+            }
+            else if (fileStat.st_size == 0)
+            {
+               finish(index, true);
+            }
+            else
+            {
+               request.data.resize(static_cast<std::size_t>(fileStat.st_size));
+               queueRead(index);
+            }
+         }
+         else
+         {
+            // Read completed
+            request.offset += static_cast<std::size_t>(completion.res);
+            if (completion.res == 0 || request.offset == request.data.size())
+            {
+               request.data.resize(request.offset);
+               finish(index, true);
+            }
+            else
+            {
+               queueRead(index);
+            }
+         }
+      };
+
+      while (!ringFailed && (nextIndex < paths.size() || numInFlight > 0))
+      {
+         while (nextIndex < paths.size() && numInFlight < maxInFlight && queueOpen(nextIndex))
+         {
+            ++nextIndex;
+            ++numInFlight;
+         }
+
+         if (!ring.submitAndWait(1))
+         {
+            ringFailed = true;
+            break;
+         }
+
+         ring.forEachCompletion(handleCompletion);
+      }
+
+      // Operations that are still in flight can write into their buffers at any time, so cancel them and wait for them before anything is freed
+      if (numInFlight > 0)
+      {
+         for (std::size_t index = 0; index < nextIndex; ++index)
+         {
+            if (requests[index].inFlight)
+            {
+               io_uring_sqe* submission = ring.getSubmission();
+               if (!submission)
+               {
+                  break; // The queue is full, draining still waits for everything
+               }
+
+               submission->opcode = IORING_OP_ASYNC_CANCEL;
+               submission->addr = index;
+               submission->user_data = kCancelUserData;
+            }
+         }
+
+         while (numInFlight > 0 && ring.submitAndWait(1))
+         {
+            ring.forEachCompletion(handleCompletion);
+         }
+
+         // The ring is unusable, so there's no way to know when the kernel is done with the buffers, leak them rather than risk it writing into freed memory
+         for (Request& request : requests)
+         {
+            if (request.inFlight)
+            {
+               new std::vector<uint8_t>(std::move(request.data));
+            }
+         }
+      }
+
+      // If the ring failed, fall back to reading anything left over synchronously
+      for (std::size_t index = 0; index < paths.size(); ++index)
+      {
+         Request& request = requests[index];
+         if (!request.finished)
+         {
+            if (request.fd >= 0)
+            {
+               close(request.fd);
+               request.fd = -1;
+            }
+
+            request.finished = true;
+            function(index, readFileSynchronously(paths[index]));
+         }
+      }
+
+      return true;
+   }
+
    class DirectoryWatcher::Impl
    {
    public:
@@ -101,20 +683,25 @@ namespace OSUtils
          close(eventQueue);
       }
 
-      void update()
+      bool hasPendingEvents() const
       {
-         std::vector<Notification> notifications;
-
          pollfd pollData{};
          pollData.fd = eventQueue;
          pollData.events = POLLIN;
 
          int numSet = ::poll(&pollData, 1, 0);
-         if (numSet <= 0 || !(pollData.revents & pollData.events) || (pollData.revents & (POLLERR | POLLHUP | POLLNVAL)))
+         return numSet > 0 && (pollData.revents & pollData.events) && !(pollData.revents & (POLLERR | POLLHUP | POLLNVAL));
+      }
+
+      void update()
+      {
+         if (!hasPendingEvents())
          {
             return;
          }
 
+         std::vector<Notification> notifications;
+
          while (true)
          {
             std::array<uint8_t, sizeof(inotify_event) + MAXPATHLEN + 1> buffer{};
@@ -236,10 +823,7 @@ namespace OSUtils
          {
             if (add(dir) && recursive)
             {
-               for (const std::filesystem::path& subPath : std::filesystem::recursive_directory_iterator(dir))
-               {
-                  add(subPath);
-               }
+               addSubdirectories(dir);
             }
          }
 
@@ -286,10 +870,7 @@ namespace OSUtils
                   {
                      if (add(absolutePath))
                      {
-                        for (const std::filesystem::path& subPath : std::filesystem::recursive_directory_iterator(absolutePath))
-                        {
-                           add(subPath);
-                        }
+                        addSubdirectories(absolutePath);
                      }
                   }
                }
@@ -308,11 +889,11 @@ namespace OSUtils
 
          bool add(const std::filesystem::path& directory)
          {
-            if (!std::filesystem::is_directory(directory))
-            {
-               return false;
-            }
+            return std::filesystem::is_directory(directory) && addDirectory(directory);
+         }
 
+         bool addDirectory(const std::filesystem::path& directory)
+         {
             int descriptor = inotify_add_watch(eventQueue, directory.c_str(), kMask);
             if (descriptor >= 0)
             {
@@ -327,6 +908,44 @@ namespace OSUtils
             return false;
          }
 
+         // Walks the tree on the calling thread, using the types getdents64() reports to avoid stat-ing each entry
+         void addSubdirectories(const std::filesystem::path& directory)
+         {
+            std::vector<std::filesystem::path> pendingDirectories = { directory };
+            std::vector<std::filesystem::path> symlinks;
+            while (!pendingDirectories.empty())
+            {
+               std::filesystem::path parent = std::move(pendingDirectories.back());
+               pendingDirectories.pop_back();
+
+               std::size_t numPending = pendingDirectories.size();
+               listDirectory(parent, [&parent, &pendingDirectories, &symlinks](std::basic_string_view<std::filesystem::path::value_type> name, DirectoryEntryType type)
+               {
+                  if (type == DirectoryEntryType::Directory)
+                  {
+                     pendingDirectories.push_back(parent / name);
+                  }
+                  else if (type == DirectoryEntryType::Symlink)
+                  {
+                     symlinks.push_back(parent / name);
+                  }
+               });
+
+               // Already known to be directories, no need to stat them again
+               for (std::size_t i = numPending; i < pendingDirectories.size(); ++i)
+               {
+                  addDirectory(pendingDirectories[i]);
+               }
+
+               // Symlinks aren't descended into, but are still watched if they point to a directory (add() checks)
+               for (const std::filesystem::path& symlink : symlinks)
+               {
+                  add(symlink);
+               }
+               symlinks.clear();
+            }
+         }
+
          void remove(const std::filesystem::path& directory)
          {
             auto location = descriptorsByDirectory.find(directory);
@@ -373,6 +992,11 @@ namespace OSUtils
       impl->update();
    }
 
+   bool DirectoryWatcher::hasPendingEvents() const
+   {
+      return impl->hasPendingEvents();
+   }
+
    DirectoryWatcher::ID DirectoryWatcher::addWatch(const std::filesystem::path& directory, bool recursive, DirectoryWatcher::NotifyFunction notifyFunction)
    {
       return impl->addWatch(directory, recursive, std::move(notifyFunction));
@@ -382,4 +1006,251 @@ namespace OSUtils
    {
       impl->removeWatch(id);
    }
+
+   namespace
+   {
+      int getTimeoutMilliseconds(std::chrono::steady_clock::duration duration)
+      {
+         int64_t milliseconds = std::chrono::ceil<std::chrono::milliseconds>(duration).count();
+         return static_cast<int>(std::clamp<int64_t>(milliseconds, 0, std::numeric_limits<int>::max()));
+      }
+   }
+
+   ProcessHandle::NativeHandle openProcessHandle(ProcessHandle::ID processId)
+   {
+#if defined(SYS_pidfd_open)
+      int pidFd = static_cast<int>(syscall(SYS_pidfd_open, static_cast<pid_t>(processId), 0));
+      if (pidFd >= 0)
+      {
+         return pidFd;
+      }
+#endif
+
+      return ProcessHandle::kInvalidHandle;
+   }
+
+   void waitForProcessExit(ProcessHandle::ID processId, ProcessHandle::NativeHandle nativeHandle, std::chrono::milliseconds timeout)
+   {
+      std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+
+      if (nativeHandle != ProcessHandle::kInvalidHandle)
+      {
+         pollfd pollData{};
+         pollData.fd = static_cast<int>(nativeHandle);
+         pollData.events = POLLIN;
+
+         while (::poll(&pollData, 1, getTimeoutMilliseconds(deadline - std::chrono::steady_clock::now())) < 0 && errno == EINTR)
+         {
+         }
+
+         return;
+      }
+
+      // Without a pidfd, all that's left is checking periodically (WNOWAIT leaves the process to be reaped by its handle)
+      static const std::chrono::milliseconds kPollInterval(1);
+      while (true)
+      {
+         siginfo_t info{};
+         if (waitid(P_PID, static_cast<id_t>(processId), &info, WEXITED | WNOHANG | WNOWAIT) != 0 || info.si_pid != 0)
+         {
+            return;
+         }
+
+         std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+         if (now >= deadline)
+         {
+            return;
+         }
+
+         std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(kPollInterval, deadline - now));
+      }
+   }
+
+   class ProcessReactor::Impl
+   {
+   public:
+      Impl()
+         : epollFd(epoll_create1(EPOLL_CLOEXEC))
+      {
+      }
+
+      ~Impl()
+      {
+         processes.clear();
+
+         if (epollFd != -1)
+         {
+            close(epollFd);
+         }
+      }
+
+      void add(ProcessHandle process, ExitFunction exitFunction)
+      {
+         uint64_t key = nextKey++;
+
+         bool watched = false;
+         if (epollFd != -1 && process.getNativeHandle() != ProcessHandle::kInvalidHandle)
+         {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = key;
+            watched = epoll_ctl(epollFd, EPOLL_CTL_ADD, static_cast<int>(process.getNativeHandle()), &event) == 0;
+         }
+
+         if (!watched)
+         {
+            unwatchedKeys.push_back(key);
+         }
+
+         processes.emplace(key, Entry{ std::move(process), std::move(exitFunction), watched });
+      }
+
+      std::size_t wait(std::optional<std::chrono::milliseconds> timeout)
+      {
+         static const int kMaxEvents = 64;
+         static const std::chrono::milliseconds kUnwatchedPollInterval(10);
+
+         if (processes.empty())
+         {
+            return 0;
+         }
+
+         std::optional<std::chrono::steady_clock::time_point> deadline;
+         if (timeout)
+         {
+            deadline = std::chrono::steady_clock::now() + *timeout;
+         }
+
+         std::vector<uint64_t> exitedKeys;
+         while (true)
+         {
+            // Processes without a pidfd can only be checked periodically
+            for (uint64_t key : unwatchedKeys)
+            {
+               if (processes.at(key).process.tryWait())
+               {
+                  exitedKeys.push_back(key);
+               }
+            }
+
+            int timeoutMilliseconds = -1;
+            if (!exitedKeys.empty())
+            {
+               timeoutMilliseconds = 0;
+            }
+            else
+            {
+               if (deadline)
+               {
+                  timeoutMilliseconds = getTimeoutMilliseconds(*deadline - std::chrono::steady_clock::now());
+               }
+
+               if (!unwatchedKeys.empty())
+               {
+                  int pollInterval = static_cast<int>(kUnwatchedPollInterval.count());
+                  timeoutMilliseconds = timeoutMilliseconds < 0 ? pollInterval : std::min(timeoutMilliseconds, pollInterval);
+               }
+            }
+
+            if (epollFd != -1)
+            {
+               std::array<epoll_event, kMaxEvents> events{};
+               int numEvents = epoll_wait(epollFd, events.data(), kMaxEvents, timeoutMilliseconds);
+               for (int i = 0; i < numEvents; ++i)
+               {
+                  auto location = processes.find(events[i].data.u64);
+                  if (location != processes.end() && location->second.process.tryWait())
+                  {
+                     exitedKeys.push_back(location->first);
+                  }
+               }
+            }
+            else
+            {
+               // Everything is unwatched, so there's always a timeout
+               std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMilliseconds));
+            }
+
+            if (!exitedKeys.empty() || (deadline && std::chrono::steady_clock::now() >= *deadline))
+            {
+               break;
+            }
+         }
+
+         return notify(exitedKeys);
+      }
+
+      std::size_t getNumProcesses() const
+      {
+         return processes.size();
+      }
+
+   private:
+      struct Entry
+      {
+         ProcessHandle process;
+         ExitFunction exitFunction;
+         bool watched = false;
+      };
+
+      std::size_t notify(const std::vector<uint64_t>& exitedKeys)
+      {
+         // Everything is removed before calling any of the functions, so they're free to add processes
+         std::vector<Entry> exitedEntries;
+         exitedEntries.reserve(exitedKeys.size());
+         for (uint64_t key : exitedKeys)
+         {
+            Entry entry = std::move(processes.extract(key).mapped());
+            if (entry.watched)
+            {
+               epoll_ctl(epollFd, EPOLL_CTL_DEL, static_cast<int>(entry.process.getNativeHandle()), nullptr);
+            }
+            else
+            {
+               unwatchedKeys.erase(std::find(unwatchedKeys.begin(), unwatchedKeys.end(), key));
+            }
+
+            exitedEntries.push_back(std::move(entry));
+         }
+
+         for (Entry& entry : exitedEntries)
+         {
+            if (entry.exitFunction)
+            {
+               entry.exitFunction(entry.process);
+            }
+         }
+
+         return exitedEntries.size();
+      }
+
+      int epollFd = -1;
+      std::unordered_map<uint64_t, Entry> processes;
+      std::vector<uint64_t> unwatchedKeys; // Processes without a pidfd
+      uint64_t nextKey = 0;
+   };
+
+   ProcessReactor::ProcessReactor()
+      : impl(std::make_unique<Impl>())
+   {
+   }
+
+   ProcessReactor::~ProcessReactor()
+   {
+   }
+
+   void ProcessReactor::add(ProcessHandle process, ExitFunction exitFunction)
+   {
+      impl->add(std::move(process), std::move(exitFunction));
+   }
+
+   std::size_t ProcessReactor::wait(std::optional<std::chrono::milliseconds> timeout)
+   {
+      return impl->wait(timeout);
+   }
+
+   std::size_t ProcessReactor::getNumProcesses() const
+   {
+      return impl->getNumProcesses();
+   }
 }
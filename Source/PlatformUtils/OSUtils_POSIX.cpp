@@ -1,12 +1,34 @@
 #include "PlatformUtils/OSUtils.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <climits>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <span>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -14,154 +36,2149 @@ extern char** environ;
 
 namespace OSUtils
 {
+   // Implemented in OSUtils_Common.cpp
+   void appendProcessOutput(std::string& output, std::string_view data, const ProcessOutputFunction& function, std::optional<std::size_t> maxOutputSize, bool& truncated);
+
+   // Implemented in ExecutableResolver.cpp
+   std::filesystem::path resolveExecutablePath(const std::filesystem::path& path); // Bare names are looked up on PATH
+
+   // Implemented per platform
+   ProcessHandle::NativeHandle openProcessHandle(ProcessHandle::ID processId);
+   void waitForProcessExit(ProcessHandle::ID processId, ProcessHandle::NativeHandle nativeHandle, std::chrono::milliseconds timeout); // Returns early once the process has exited, without reaping it
+
+   namespace
+   {
+      std::string makeTemporaryFileName()
+      {
+         static std::atomic<uint64_t> counter = { std::random_device{}() };
+
+         std::stringstream nameStream;
+         nameStream << ".tmp" << getpid() << "." << std::hex << counter.fetch_add(1);
+         return nameStream.str();
+      }
+
+      std::filesystem::path getDirectoryPath(const std::filesystem::path& directory)
+      {
+         return directory.empty() ? std::filesystem::path(".") : directory;
+      }
+
+      int openNamedTemporaryFile(const std::filesystem::path& directoryPath, std::filesystem::path& temporaryPath)
+      {
+         static const int kMaxAttempts = 16;
+         for (int i = 0; i < kMaxAttempts; ++i)
+         {
+            temporaryPath = directoryPath / makeTemporaryFileName();
+
+            int fd = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+            if (fd >= 0 || errno != EEXIST)
+            {
+               return fd;
+            }
+         }
+
+         return -1;
+      }
+
+#if defined(O_TMPFILE)
+      // Anonymous files can only be linked into a directory through /proc (linkat() with AT_EMPTY_PATH needs privileges)
+      bool canLinkAnonymousFiles()
+      {
+         static const bool kProcMounted = access("/proc/self/fd", X_OK) == 0;
+         return kProcMounted;
+      }
+#endif
+
+      // The pipes are close-on-exec, the child only keeps the ends that get duplicated onto its stdout / stderr
+      bool createPipe(int fds[2])
+      {
+#if defined(__APPLE__)
+         if (pipe(fds) != 0)
+         {
+            return false;
+         }
+
+         fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+         fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+         return true;
+#else
+         return pipe2(fds, O_CLOEXEC) == 0;
+#endif
+      }
+
+      // argv[0] points into path (whose characters are stored inline when it's short), so it can't be copied or moved, only constructed where it's used
+      struct ExecArguments
+      {
+         // Points into startInfo's args, so it has to outlive this
+         // The path is used as it is, so it has to have been resolved already
+         ExecArguments(ProcessStartInfo& startInfo, std::string resolvedPath)
+            : path(std::move(resolvedPath))
+            , environment(startInfo.environment ? *startInfo.environment : EnvironmentBlock(startInfo.env, startInfo.inheritEnvironment))
+         {
+            argv.reserve(startInfo.args.size() + 2);
+            argv.push_back(path.data());
+            for (std::string& arg : startInfo.args)
+            {
+               argv.push_back(arg.data());
+            }
+            argv.push_back(nullptr);
+         }
+
+         ExecArguments(const ExecArguments& other) = delete;
+         ExecArguments& operator=(const ExecArguments& other) = delete;
+
+         std::string path;
+         std::vector<char*> argv;
+         EnvironmentBlock environment;
+      };
+
+      ExecArguments prepareExecArguments(ProcessStartInfo& startInfo)
+      {
+         return ExecArguments(startInfo, resolveExecutablePath(startInfo.path).string());
+      }
+
+      char* const* getEnvp(const ExecArguments& execArguments)
+      {
+         return static_cast<char* const*>(execArguments.environment.getNativeBlock());
+      }
+
+      struct ReapedStatus
+      {
+         std::optional<int> exitCode;
+         std::optional<int> terminationSignal;
+         rusage usage{};
+      };
+
+      // Returns true once the process has been reaped (or turned out to be gone already)
+      bool reap(pid_t pid, int options, ReapedStatus& reapedStatus)
+      {
+         int status = 0;
+         pid_t result = -1;
+         do
+         {
+            result = wait4(pid, &status, options, &reapedStatus.usage);
+         } while (result == -1 && errno == EINTR);
+
+         if (result == pid)
+         {
+            if (WIFEXITED(status))
+            {
+               reapedStatus.exitCode = WEXITSTATUS(status);
+            }
+            else if (WIFSIGNALED(status))
+            {
+               reapedStatus.terminationSignal = WTERMSIG(status);
+            }
+
+            return true;
+         }
+
+         return result == -1 && errno == ECHILD; // Reaped by someone else, so the exit code is lost
+      }
+
+      bool reap(pid_t pid, int options, std::optional<int>& exitCode)
+      {
+         ReapedStatus reapedStatus;
+         bool reaped = reap(pid, options, reapedStatus);
+         if (reapedStatus.exitCode)
+         {
+            exitCode = reapedStatus.exitCode;
+         }
+
+         return reaped;
+      }
+
+      // Without reaping it, so its ID (and process group) can't be reused yet
+      bool hasExited(pid_t pid)
+      {
+         siginfo_t info{};
+         return waitid(P_PID, static_cast<id_t>(pid), &info, WEXITED | WNOHANG | WNOWAIT) != 0 || info.si_pid != 0;
+      }
+
+      std::chrono::microseconds toMicroseconds(const timeval& time)
+      {
+         return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec);
+      }
+
+      void setResourceUsage(ProcessExitInfo& exitInfo, const rusage& usage)
+      {
+         exitInfo.userTime = toMicroseconds(usage.ru_utime);
+         exitInfo.systemTime = toMicroseconds(usage.ru_stime);
+
+#if defined(__APPLE__)
+         exitInfo.peakResidentSize = static_cast<uint64_t>(usage.ru_maxrss); // In bytes
+#else
+         exitInfo.peakResidentSize = static_cast<uint64_t>(usage.ru_maxrss) * 1024; // In kilobytes
+#endif
+      }
+
+      // Only once it has been reaped here (if someone else reaped it, its status is gone)
+      std::optional<ProcessExitInfo> getExitInfo(const ReapedStatus& reapedStatus, std::chrono::steady_clock::time_point launchTime, ProcessExitInfo exitInfo = {})
+      {
+         if (!reapedStatus.exitCode && !reapedStatus.terminationSignal)
+         {
+            return std::nullopt;
+         }
+
+         exitInfo.exitCode = reapedStatus.exitCode ? *reapedStatus.exitCode : 128 + *reapedStatus.terminationSignal;
+         exitInfo.terminationSignal = reapedStatus.terminationSignal;
+         exitInfo.wallTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - launchTime);
+         setResourceUsage(exitInfo, reapedStatus.usage);
+
+         return exitInfo;
+      }
+
+      bool reap(pid_t pid, int options, std::chrono::steady_clock::time_point launchTime, std::optional<ProcessExitInfo>& exitInfo)
+      {
+         ReapedStatus reapedStatus;
+         bool reaped = reap(pid, options, reapedStatus);
+         if (reaped)
+         {
+            exitInfo = getExitInfo(reapedStatus, launchTime);
+         }
+
+         return reaped;
+      }
+
+      // Terminates processes (and everything else in their process groups) once their timeouts pass: SIGTERM first, then SIGKILL once the grace period has passed too
+      class DeadlineEnforcer
+      {
+      public:
+         void add(pid_t pid, const ProcessStartInfo& startInfo, bool& timedOut)
+         {
+            if (startInfo.timeout)
+            {
+               deadlines.push_back(Deadline{ pid, std::chrono::steady_clock::now() + *startInfo.timeout, startInfo.killGracePeriod, &timedOut });
+            }
+         }
+
+         // Sends any signals that are due, returning how long until the next one is (std::nullopt once there are none left)
+         std::optional<std::chrono::steady_clock::duration> enforce()
+         {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+            std::optional<std::chrono::steady_clock::duration> untilNext;
+            for (Deadline& deadline : deadlines)
+            {
+               if (deadline.done)
+               {
+                  continue;
+               }
+
+               if (now >= deadline.time)
+               {
+                  if (deadline.terminating)
+                  {
+                     kill(-deadline.pid, SIGKILL);
+                     deadline.done = true;
+                     continue;
+                  }
+
+                  // If it has exited already (it's just not been reaped yet), this only catches whatever it left running (e.g. holding its pipes open)
+                  *deadline.timedOut = !hasExited(deadline.pid);
+                  deadline.terminating = true;
+                  kill(-deadline.pid, SIGTERM);
+                  deadline.time = now + deadline.gracePeriod;
+               }
+
+               untilNext = std::min(untilNext.value_or(deadline.time - now), deadline.time - now);
+            }
+
+            removeDone();
+            return untilNext;
+         }
+
+         // Called once the process has exited, before it's reaped (while its process group is sure to still be its own)
+         // If it's being terminated, anything left in its group is killed right away rather than after the grace period
+         void finish(pid_t pid)
+         {
+            for (Deadline& deadline : deadlines)
+            {
+               if (deadline.pid == pid && !deadline.done)
+               {
+                  if (deadline.terminating)
+                  {
+                     kill(-pid, SIGKILL);
+                  }
+
+                  deadline.done = true;
+               }
+            }
+
+            removeDone();
+         }
+
+      private:
+         struct Deadline
+         {
+            pid_t pid = -1;
+            std::chrono::steady_clock::time_point time;
+            std::chrono::milliseconds gracePeriod;
+            bool* timedOut = nullptr;
+            bool terminating = false;
+            bool done = false;
+         };
+
+         // So that one that's used for a long time (like the fork server's) doesn't keep growing
+         void removeDone()
+         {
+            std::erase_if(deadlines, [](const Deadline& deadline) { return deadline.done; });
+         }
+
+         std::vector<Deadline> deadlines;
+      };
+
+      int getPollTimeout(std::optional<std::chrono::steady_clock::duration> duration)
+      {
+         if (!duration)
+         {
+            return -1;
+         }
+
+         int64_t milliseconds = std::chrono::ceil<std::chrono::milliseconds>(*duration).count();
+         return static_cast<int>(std::clamp<int64_t>(milliseconds, 0, INT_MAX));
+      }
+
+      // Descriptors the child gets as its stdin / stdout / stderr (-1 to share ours)
+      struct StandardStreams
+      {
+         int in = -1;
+         int out = -1;
+         int err = -1;
+      };
+
+      void closeStreams(StandardStreams& streams)
+      {
+         for (int* fd : { &streams.in, &streams.out, &streams.err })
+         {
+            if (*fd != -1)
+            {
+               close(*fd);
+               *fd = -1;
+            }
+         }
+      }
+
+      // Writes stdInData / stdInFunction's output to the child's stdin, as much at a time as the (non-blocking) pipe takes
+      class InputFeeder
+      {
+      public:
+         InputFeeder(const ProcessStartInfo& processStartInfo)
+            : startInfo(processStartInfo)
+         {
+            if (!startInfo.stdInFunction && startInfo.stdInData)
+            {
+               pending = *startInfo.stdInData;
+            }
+         }
+
+         // Returns false once everything has been written (or the child stopped reading)
+         bool write(int fd)
+         {
+            static const std::size_t kBufferSize = 64 * 1024;
+
+            while (true)
+            {
+               if (pending.empty())
+               {
+                  if (!startInfo.stdInFunction)
+                  {
+                     return false;
+                  }
+
+                  buffer.resize(kBufferSize);
+                  std::size_t size = std::min(startInfo.stdInFunction(std::span<char>(buffer)), buffer.size());
+                  if (size == 0)
+                  {
+                     return false;
+                  }
+
+                  pending = std::string_view(buffer.data(), size);
+               }
+
+               ssize_t numBytesWritten = ::write(fd, pending.data(), pending.size());
+               if (numBytesWritten > 0)
+               {
+                  pending.remove_prefix(numBytesWritten);
+               }
+               else if (numBytesWritten < 0 && errno != EINTR)
+               {
+                  return errno == EAGAIN; // Full for now, anything else (e.g. EPIPE) means the child isn't reading anymore
+               }
+            }
+         }
+
+      private:
+         const ProcessStartInfo& startInfo;
+         std::string_view pending;
+         std::vector<char> buffer;
+      };
+
+      // Writing to a pipe that nobody reads from anymore raises SIGPIPE (which would kill us), so it's blocked while feeding input, and discarded if it was raised
+      class SigPipeBlocker
+      {
+      public:
+         SigPipeBlocker()
+         {
+            sigemptyset(&sigPipeSet);
+            sigaddset(&sigPipeSet, SIGPIPE);
+            pthread_sigmask(SIG_BLOCK, &sigPipeSet, &previousMask);
+
+            wasPending = isPending();
+         }
+
+         SigPipeBlocker(const SigPipeBlocker& other) = delete;
+
+         ~SigPipeBlocker()
+         {
+            if (!wasPending && isPending())
+            {
+               int signal = 0;
+               sigwait(&sigPipeSet, &signal);
+            }
+
+            pthread_sigmask(SIG_SETMASK, &previousMask, nullptr);
+         }
+
+         SigPipeBlocker& operator=(const SigPipeBlocker& other) = delete;
+
+      private:
+         bool isPending() const
+         {
+            sigset_t pendingSignals;
+            sigemptyset(&pendingSignals);
+            sigpending(&pendingSignals);
+
+            return sigismember(&pendingSignals, SIGPIPE) == 1;
+         }
+
+         sigset_t sigPipeSet;
+         sigset_t previousMask;
+         bool wasPending = false;
+      };
+
+      struct OutputSink
+      {
+         int fd = -1;
+         ProcessExitInfo* exitInfo = nullptr;
+         const ProcessStartInfo* startInfo = nullptr;
+         bool isStdErr = false;
+      };
+
+      // Feeds the input and reads all of the outputs as the children are ready for it, until every pipe is done with (and closed)
+      // Nothing can block on a full pipe while we're busy with another one (or waiting for a child to exit)
+      void exchangeData(std::optional<InputFeeder>& inputFeeder, int inputFd, std::vector<OutputSink>& sinks, DeadlineEnforcer& deadlineEnforcer)
+      {
+         static const std::size_t kBufferSize = 64 * 1024;
+
+         std::vector<pollfd> pollFds(sinks.size() + 1);
+         for (std::size_t i = 0; i < sinks.size(); ++i)
+         {
+            pollFds[i].fd = sinks[i].fd;
+            pollFds[i].events = POLLIN;
+         }
+
+         pollfd& inputPollFd = pollFds.back();
+         inputPollFd.fd = inputFeeder ? inputFd : -1;
+         inputPollFd.events = POLLOUT;
+
+         std::optional<SigPipeBlocker> sigPipeBlocker;
+         if (inputFeeder)
+         {
+            sigPipeBlocker.emplace();
+         }
+
+         std::vector<char> buffer(kBufferSize);
+         auto isDone = [](const pollfd& pollFd) { return pollFd.fd == -1; };
+         while (!std::all_of(pollFds.begin(), pollFds.end(), isDone))
+         {
+            if (poll(pollFds.data(), pollFds.size(), getPollTimeout(deadlineEnforcer.enforce())) < 0)
+            {
+               if (errno == EINTR)
+               {
+                  continue;
+               }
+
+               break;
+            }
+
+            for (std::size_t i = 0; i < sinks.size(); ++i)
+            {
+               if (pollFds[i].fd == -1 || pollFds[i].revents == 0)
+               {
+                  continue;
+               }
+
+               ssize_t numBytesRead = read(pollFds[i].fd, buffer.data(), buffer.size());
+               if (numBytesRead > 0)
+               {
+                  const OutputSink& sink = sinks[i];
+                  std::string& output = sink.isStdErr ? sink.exitInfo->stdErr : sink.exitInfo->stdOut;
+                  const ProcessOutputFunction& function = sink.isStdErr ? sink.startInfo->stdErrFunction : sink.startInfo->stdOutFunction;
+                  appendProcessOutput(output, std::string_view(buffer.data(), numBytesRead), function, sink.startInfo->maxOutputSize, sink.exitInfo->outputTruncated);
+               }
+               else if (numBytesRead == 0 || (errno != EINTR && errno != EAGAIN))
+               {
+                  close(pollFds[i].fd);
+                  pollFds[i].fd = -1; // Ignored by poll from now on
+               }
+            }
+
+            // Closing the pipe once all of the input is written is what tells the child it's the end
+            if (inputPollFd.fd != -1 && inputPollFd.revents != 0 && !inputFeeder->write(inputPollFd.fd))
+            {
+               close(inputPollFd.fd);
+               inputPollFd.fd = -1;
+            }
+         }
+
+         // Only left open if poll failed
+         for (pollfd& pollFd : pollFds)
+         {
+            if (pollFd.fd != -1)
+            {
+               close(pollFd.fd);
+            }
+         }
+      }
+
+      // posix_spawn is implemented with vfork / clone(CLONE_VM | CLONE_VFORK) (or directly by the kernel), so unlike fork, the parent's page tables aren't copied
+      std::optional<pid_t> spawn(const ExecArguments& execArguments, const StandardStreams& streams, bool newProcessGroup)
+      {
+         posix_spawn_file_actions_t fileActions;
+         if (posix_spawn_file_actions_init(&fileActions) != 0)
+         {
+            return std::nullopt;
+         }
+
+         posix_spawnattr_t attributes;
+         if (posix_spawnattr_init(&attributes) != 0)
+         {
+            posix_spawn_file_actions_destroy(&fileActions);
+            return std::nullopt;
+         }
+
+         if (newProcessGroup)
+         {
+            posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+            posix_spawnattr_setpgroup(&attributes, 0);
+         }
+
+         if (streams.in != -1)
+         {
+            posix_spawn_file_actions_adddup2(&fileActions, streams.in, STDIN_FILENO);
+         }
+         if (streams.out != -1)
+         {
+            posix_spawn_file_actions_adddup2(&fileActions, streams.out, STDOUT_FILENO);
+         }
+         if (streams.err != -1)
+         {
+            posix_spawn_file_actions_adddup2(&fileActions, streams.err, STDERR_FILENO);
+         }
+
+         pid_t pid = -1;
+         int result = posix_spawn(&pid, execArguments.path.c_str(), &fileActions, &attributes, execArguments.argv.data(), getEnvp(execArguments));
+         posix_spawnattr_destroy(&attributes);
+         posix_spawn_file_actions_destroy(&fileActions);
+
+         if (result != 0)
+         {
+            return std::nullopt;
+         }
+
+         return pid;
+      }
+
+      std::optional<pid_t> forkAndExec(const ExecArguments& execArguments, const StandardStreams& streams, bool newProcessGroup)
+      {
+         // If exec fails, the child sends errno back through this, otherwise exec closes it (so failures are reported like posix_spawn() reports them)
+         int errorPipe[2]{ -1, -1 };
+         if (!createPipe(errorPipe))
+         {
+            return std::nullopt;
+         }
+
+         // Anything still buffered would otherwise be written twice (once by the child)
+         fflush(stdout);
+         fflush(stderr);
+
+         pid_t pid = fork();
+         if (pid == -1)
+         {
+            close(errorPipe[0]);
+            close(errorPipe[1]);
+            return std::nullopt;
+         }
+
+         if (pid == 0)
+         {
+            // Child process, only async-signal-safe functions from here on
+
+            close(errorPipe[0]);
+
+            if (newProcessGroup)
+            {
+               setpgid(0, 0);
+            }
+
+            if (streams.in != -1)
+            {
+               dup2(streams.in, STDIN_FILENO);
+            }
+            if (streams.out != -1)
+            {
+               dup2(streams.out, STDOUT_FILENO);
+            }
+            if (streams.err != -1)
+            {
+               dup2(streams.err, STDERR_FILENO);
+            }
+
+            execve(execArguments.path.c_str(), execArguments.argv.data(), getEnvp(execArguments));
+
+            int error = errno;
+            [[maybe_unused]] ssize_t result = write(errorPipe[1], &error, sizeof(error));
+            _exit(127);
+         }
+
+         close(errorPipe[1]);
+
+         // Also done here, so the group exists as soon as we return (whichever of us gets there first)
+         if (newProcessGroup)
+         {
+            setpgid(pid, pid);
+         }
+
+         int error = 0;
+         ssize_t numBytesRead = -1;
+         do
+         {
+            numBytesRead = read(errorPipe[0], &error, sizeof(error));
+         } while (numBytesRead == -1 && errno == EINTR);
+         close(errorPipe[0]);
+
+         if (numBytesRead > 0)
+         {
+            ReapedStatus reapedStatus;
+            reap(pid, 0, reapedStatus);
+
+            return std::nullopt;
+         }
+
+         return pid;
+      }
+
+      std::optional<pid_t> launch(const ExecArguments& execArguments, ProcessLaunchMethod launchMethod, const StandardStreams& streams, bool newProcessGroup = false)
+      {
+         if (launchMethod == ProcessLaunchMethod::Fork)
+         {
+            return forkAndExec(execArguments, streams, newProcessGroup);
+         }
+
+         return spawn(execArguments, streams, newProcessGroup);
+      }
+
+      int openInputFile(const std::filesystem::path& path)
+      {
+         return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      }
+
+      bool hasInputToFeed(const ProcessStartInfo& startInfo)
+      {
+         return startInfo.stdInFunction || startInfo.stdInData;
+      }
+
+      // Launches the processes with each one's stdout connected to the next one's stdin, exchanges data with them while they run, then waits for all of them
+      std::vector<std::optional<ProcessExitInfo>> runPipeline(std::vector<ProcessStartInfo>& startInfos)
+      {
+         std::size_t numProcesses = startInfos.size();
+         std::vector<std::optional<ProcessExitInfo>> exitInfos(numProcesses);
+         if (numProcesses == 0)
+         {
+            return exitInfos;
+         }
+
+         // Everything is prepared before launching, so the child doesn't allocate (which isn't safe after forking a multithreaded process)
+         std::deque<ExecArguments> execArguments;
+         for (ProcessStartInfo& startInfo : startInfos)
+         {
+            execArguments.emplace_back(startInfo, resolveExecutablePath(startInfo.path).string());
+         }
+
+         const ProcessStartInfo& firstStartInfo = startInfos.front();
+         std::optional<InputFeeder> inputFeeder;
+         int inputFd = -1;
+         int nextIn = -1;
+         if (hasInputToFeed(firstStartInfo))
+         {
+            int inPipe[2]{ -1, -1 };
+            if (!createPipe(inPipe))
+            {
+               return exitInfos;
+            }
+
+            fcntl(inPipe[1], F_SETFL, fcntl(inPipe[1], F_GETFL) | O_NONBLOCK);
+            inputFeeder.emplace(firstStartInfo);
+            inputFd = inPipe[1];
+            nextIn = inPipe[0];
+         }
+         else if (!firstStartInfo.stdInPath.empty())
+         {
+            nextIn = openInputFile(firstStartInfo.stdInPath);
+            if (nextIn == -1)
+            {
+               return exitInfos;
+            }
+         }
+
+         std::vector<ProcessExitInfo> results(numProcesses);
+         std::vector<OutputSink> sinks;
+         std::vector<std::optional<pid_t>> pids(numProcesses);
+         std::vector<std::chrono::steady_clock::time_point> launchTimes(numProcesses);
+         DeadlineEnforcer deadlineEnforcer;
+         for (std::size_t i = 0; i < numProcesses; ++i)
+         {
+            const ProcessStartInfo& startInfo = startInfos[i];
+            bool isLast = i + 1 == numProcesses;
+
+            StandardStreams streams;
+            streams.in = std::exchange(nextIn, -1);
+
+            bool streamsCreated = true;
+            if (!isLast || startInfo.readOutput)
+            {
+               int outPipe[2]{ -1, -1 };
+               streamsCreated &= createPipe(outPipe);
+               streams.out = outPipe[1];
+
+               if (!isLast)
+               {
+                  nextIn = outPipe[0];
+               }
+               else if (outPipe[0] != -1)
+               {
+                  sinks.push_back(OutputSink{ outPipe[0], &results[i], &startInfo, false });
+               }
+            }
+
+            if (startInfo.readOutput)
+            {
+               int errPipe[2]{ -1, -1 };
+               streamsCreated &= createPipe(errPipe);
+               streams.err = errPipe[1];
+
+               if (errPipe[0] != -1)
+               {
+                  sinks.push_back(OutputSink{ errPipe[0], &results[i], &startInfo, true });
+               }
+            }
+
+            if (streamsCreated)
+            {
+               // With a timeout, it gets its own process group, so that everything it starts can be terminated with it
+               launchTimes[i] = std::chrono::steady_clock::now();
+               pids[i] = launch(execArguments[i], startInfo.launchMethod, streams, startInfo.timeout.has_value());
+               if (pids[i])
+               {
+                  deadlineEnforcer.add(*pids[i], startInfo, results[i].timedOut);
+               }
+            }
+
+            // The child has its own copies now (and if it couldn't be launched, its neighbours see the end of their pipes)
+            closeStreams(streams);
+         }
+
+         exchangeData(inputFeeder, inputFd, sinks, deadlineEnforcer);
+
+         for (std::size_t i = 0; i < numProcesses; ++i)
+         {
+            if (!pids[i])
+            {
+               continue;
+            }
+
+            // Deadlines still have to be enforced while waiting (which only blocks without a timeout once there are none left)
+            pid_t pid = *pids[i];
+            ProcessHandle::NativeHandle handle = ProcessHandle::kInvalidHandle;
+            while (std::optional<std::chrono::steady_clock::duration> untilDeadline = deadlineEnforcer.enforce())
+            {
+               if (hasExited(pid))
+               {
+                  break;
+               }
+
+               if (handle == ProcessHandle::kInvalidHandle)
+               {
+                  handle = openProcessHandle(pid);
+               }
+
+               waitForProcessExit(pid, handle, std::chrono::ceil<std::chrono::milliseconds>(*untilDeadline));
+            }
+
+            if (handle != ProcessHandle::kInvalidHandle)
+            {
+               close(static_cast<int>(handle));
+            }
+
+            deadlineEnforcer.finish(pid);
+
+            ReapedStatus reapedStatus;
+            if (reap(pid, 0, reapedStatus))
+            {
+               exitInfos[i] = getExitInfo(reapedStatus, launchTimes[i], std::move(results[i]));
+            }
+         }
+
+         return exitInfos;
+      }
+   }
+
+   class EnvironmentBlock::Impl
+   {
+   public:
+      Impl(const std::unordered_map<std::string, std::string>& overrides, bool inheritEnvironment)
+      {
+         // All variables are stored back to back, so there's a single allocation to fill (and envp is just pointers into it)
+         std::vector<std::size_t> offsets;
+         offsets.reserve(overrides.size());
+
+         auto addVariable = [this, &offsets](std::string_view key, std::string_view value)
+         {
+            offsets.push_back(storage.size());
+            storage.append(key);
+            storage += '=';
+            storage.append(value);
+            storage += '\0';
+         };
+
+         if (inheritEnvironment)
+         {
+            for (char** itr = environ; *itr; ++itr)
+            {
+               std::string_view envEntry = *itr;
+               std::size_t equalsIndex = envEntry.find('=');
+               if (equalsIndex != 0 && equalsIndex != std::string_view::npos && overrides.count(std::string(envEntry.substr(0, equalsIndex))) == 0) // Provided environment variables take precedence
+               {
+                  addVariable(envEntry.substr(0, equalsIndex), envEntry.substr(equalsIndex + 1));
+               }
+            }
+         }
+
+         for (const auto& [key, value] : overrides)
+         {
+            addVariable(key, value);
+         }
+
+         envp.reserve(offsets.size() + 1);
+         for (std::size_t offset : offsets)
+         {
+            envp.push_back(storage.data() + offset);
+         }
+         envp.push_back(nullptr);
+      }
+
+      std::size_t getNumVariables() const
+      {
+         return envp.size() - 1;
+      }
+
+      const void* getNativeBlock() const
+      {
+         return envp.data();
+      }
+
+   private:
+      std::string storage;
+      std::vector<char*> envp;
+   };
+
+   EnvironmentBlock::EnvironmentBlock(const std::unordered_map<std::string, std::string>& overrides, bool inheritEnvironment)
+      : impl(std::make_shared<const Impl>(overrides, inheritEnvironment))
+   {
+   }
+
+   std::size_t EnvironmentBlock::getNumVariables() const
+   {
+      return impl->getNumVariables();
+   }
+
+   const void* EnvironmentBlock::getNativeBlock() const
+   {
+      return impl->getNativeBlock();
+   }
+
    std::unordered_map<std::string, std::string> getEnvironment()
    {
-      std::unordered_map<std::string, std::string> environment;
+      std::unordered_map<std::string, std::string> environment;
+
+      for (char** itr = environ; *itr; ++itr)
+      {
+         std::string envEntry = *itr;
+         std::size_t equalsIndex = envEntry.find('=');
+         if (equalsIndex != 0 && equalsIndex != std::string::npos)
+         {
+            environment.emplace(envEntry.substr(0, equalsIndex), envEntry.substr(equalsIndex + 1));
+         }
+      }
+
+      return environment;
+   }
+
+   std::string getExecutableSearchPath()
+   {
+      const char* searchPath = getenv("PATH");
+      return searchPath ? searchPath : "";
+   }
+
+   std::vector<std::filesystem::path> splitExecutableSearchPath(const std::string& searchPath)
+   {
+      std::vector<std::filesystem::path> directories;
+
+      std::string_view remaining = searchPath;
+      while (true)
+      {
+         std::size_t separatorIndex = remaining.find(':');
+         directories.emplace_back(remaining.substr(0, separatorIndex));
+         if (separatorIndex == std::string_view::npos)
+         {
+            break;
+         }
+
+         remaining.remove_prefix(separatorIndex + 1);
+      }
+
+      return directories;
+   }
+
+   std::string getExecutableLookupName(const std::filesystem::path& name)
+   {
+      return name.string();
+   }
+
+   std::vector<std::string> getExecutableNames(const std::filesystem::path& fileName)
+   {
+      return { fileName.string() };
+   }
+
+   bool isExecutableFile(const std::filesystem::path& path)
+   {
+      struct stat info{};
+      return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode) && access(path.c_str(), X_OK) == 0;
+   }
+
+   std::optional<ProcessExitInfo> executeProcess(ProcessStartInfo startInfo)
+   {
+      if (startInfo.waitForExit)
+      {
+         std::vector<ProcessStartInfo> startInfos;
+         startInfos.push_back(std::move(startInfo));
+
+         return std::move(runPipeline(startInfos).front());
+      }
+
+      // Without waiting, there's nothing to exchange data with it, all it can read from is a file
+      startProcess(std::move(startInfo));
+      return std::nullopt;
+   }
+
+   std::vector<std::optional<ProcessExitInfo>> executePipeline(std::vector<ProcessStartInfo> startInfos)
+   {
+      return runPipeline(startInfos);
+   }
+
+   std::optional<ProcessHandle> startProcess(ProcessStartInfo startInfo)
+   {
+      ExecArguments execArguments = prepareExecArguments(startInfo);
+
+      StandardStreams streams;
+      if (!startInfo.stdInPath.empty())
+      {
+         streams.in = openInputFile(startInfo.stdInPath);
+         if (streams.in == -1)
+         {
+            return std::nullopt;
+         }
+      }
+
+      std::optional<pid_t> pid = launch(execArguments, startInfo.launchMethod, streams);
+      closeStreams(streams);
+
+      if (!pid)
+      {
+         return std::nullopt;
+      }
+
+      return ProcessHandle(*pid, openProcessHandle(*pid));
+   }
+
+   bool ProcessHandle::tryWait()
+   {
+      if (isValid() && !exited)
+      {
+         exited = reap(static_cast<pid_t>(id), WNOHANG, launchTime, exitInfo);
+      }
+
+      return exited;
+   }
+
+   bool ProcessHandle::wait(std::optional<std::chrono::milliseconds> timeout)
+   {
+      if (!isValid() || exited)
+      {
+         return exited;
+      }
+
+      if (!timeout)
+      {
+         exited = reap(static_cast<pid_t>(id), 0, launchTime, exitInfo);
+         return exited;
+      }
+
+      if (!tryWait())
+      {
+         waitForProcessExit(id, handle, *timeout);
+         tryWait();
+      }
+
+      return exited;
+   }
+
+   bool ProcessHandle::kill()
+   {
+      // Never once it's been reaped, the ID might belong to another process by then
+      return isValid() && !exited && ::kill(static_cast<pid_t>(id), SIGKILL) == 0;
+   }
+
+   void ProcessHandle::release()
+   {
+      if (isValid())
+      {
+         tryWait();
+
+         if (handle != kInvalidHandle)
+         {
+            ::close(static_cast<int>(handle));
+         }
+
+         id = kInvalidIdentifier;
+         handle = kInvalidHandle;
+         exitInfo.reset();
+         exited = false;
+      }
+   }
+
+   namespace
+   {
+      // Sent with the reply socket's descriptor and then the child's standard streams (those in streamFlags, in order) attached
+      struct ForkServerRequest
+      {
+         uint32_t payloadSize = 0; // The path, args and environment variables follow, each a length-prefixed string
+         uint32_t numArgs = 0;
+         uint32_t numEnvironmentVariables = 0;
+         uint32_t streamFlags = 0;
+         uint32_t launchMethod = 0;
+         int64_t timeoutMilliseconds = -1; // -1 for none
+         int64_t killGracePeriodMilliseconds = 0;
+      };
+
+      enum ForkServerStreamFlags : uint32_t
+      {
+         kForkServerStdIn = 1 << 0,
+         kForkServerStdOut = 1 << 1,
+         kForkServerStdErr = 1 << 2
+      };
+
+      // Sent once the process has been launched (pid is -1 if it couldn't be), then again once it has exited
+      struct ForkServerReply
+      {
+         int32_t pid = -1;
+         int32_t exited = 0;
+         int32_t exitCode = -1; // -1 if it didn't exit normally
+         int32_t terminationSignal = 0;
+         int32_t timedOut = 0;
+         int64_t userTimeMicroseconds = 0;
+         int64_t systemTimeMicroseconds = 0;
+         uint64_t peakResidentSize = 0;
+      };
+
+      static const std::size_t kMaxForkServerDescriptors = 4;
+
+#if defined(__APPLE__)
+      static const int kSendFlags = 0; // SO_NOSIGPIPE is set on the socket instead
+
+      // There's no SOCK_CLOEXEC or MSG_CMSG_CLOEXEC to do it atomically
+      void setCloseOnExec(int fd)
+      {
+         fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+      }
+#else
+      static const int kSendFlags = MSG_NOSIGNAL;
+#endif
+
+      bool createSocketPair(int fds[2])
+      {
+#if defined(__APPLE__)
+         if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+         {
+            return false;
+         }
+
+         int enable = 1;
+         for (int i = 0; i < 2; ++i)
+         {
+            setCloseOnExec(fds[i]);
+            setsockopt(fds[i], SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+         }
+
+         return true;
+#else
+         return socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0;
+#endif
+      }
+
+      // Socket writes never raise SIGPIPE, a closed peer is just a failed write
+      bool sendAll(int socket, const void* data, std::size_t size)
+      {
+         const uint8_t* bytes = static_cast<const uint8_t*>(data);
+         while (size > 0)
+         {
+            ssize_t numBytesSent = send(socket, bytes, size, kSendFlags);
+            if (numBytesSent < 0)
+            {
+               if (errno == EINTR)
+               {
+                  continue;
+               }
+
+               return false;
+            }
+
+            bytes += numBytesSent;
+            size -= numBytesSent;
+         }
+
+         return true;
+      }
+
+      bool receiveAll(int socket, void* data, std::size_t size)
+      {
+         uint8_t* bytes = static_cast<uint8_t*>(data);
+         while (size > 0)
+         {
+            ssize_t numBytesReceived = recv(socket, bytes, size, 0);
+            if (numBytesReceived <= 0)
+            {
+               if (numBytesReceived < 0 && errno == EINTR)
+               {
+                  continue;
+               }
+
+               return false;
+            }
+
+            bytes += numBytesReceived;
+            size -= numBytesReceived;
+         }
+
+         return true;
+      }
+
+      // The descriptors are attached to the first byte of the data (SCM_RIGHTS), the receiver gets its own copies of them
+      bool sendWithDescriptors(int socket, std::string_view data, std::span<const int> fds)
+      {
+         alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxForkServerDescriptors)]{};
+
+         iovec ioVector{ const_cast<char*>(data.data()), data.size() };
+         msghdr message{};
+         message.msg_iov = &ioVector;
+         message.msg_iovlen = 1;
+         message.msg_control = control;
+         message.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+         cmsghdr* controlMessage = CMSG_FIRSTHDR(&message);
+         controlMessage->cmsg_level = SOL_SOCKET;
+         controlMessage->cmsg_type = SCM_RIGHTS;
+         controlMessage->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+         std::memcpy(CMSG_DATA(controlMessage), fds.data(), sizeof(int) * fds.size());
+
+         ssize_t numBytesSent = -1;
+         do
+         {
+            numBytesSent = sendmsg(socket, &message, kSendFlags);
+         } while (numBytesSent < 0 && errno == EINTR);
+
+         if (numBytesSent <= 0)
+         {
+            return false;
+         }
+
+         return sendAll(socket, data.data() + numBytesSent, data.size() - numBytesSent);
+      }
+
+      // Returns false if the socket was closed (or failed) before all of the data arrived
+      bool receiveWithDescriptors(int socket, void* data, std::size_t size, std::vector<int>& fds)
+      {
+         alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxForkServerDescriptors)]{};
+
+         iovec ioVector{ data, size };
+         msghdr message{};
+         message.msg_iov = &ioVector;
+         message.msg_iovlen = 1;
+         message.msg_control = control;
+         message.msg_controllen = sizeof(control);
+
+#if defined(__APPLE__)
+         static const int kReceiveFlags = 0;
+#else
+         static const int kReceiveFlags = MSG_CMSG_CLOEXEC;
+#endif
+
+         ssize_t numBytesReceived = -1;
+         do
+         {
+            numBytesReceived = recvmsg(socket, &message, kReceiveFlags);
+         } while (numBytesReceived < 0 && errno == EINTR);
+
+         for (cmsghdr* controlMessage = CMSG_FIRSTHDR(&message); controlMessage; controlMessage = CMSG_NXTHDR(&message, controlMessage))
+         {
+            if (controlMessage->cmsg_level == SOL_SOCKET && controlMessage->cmsg_type == SCM_RIGHTS)
+            {
+               std::size_t numFds = (controlMessage->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+               for (std::size_t i = 0; i < numFds; ++i)
+               {
+                  int fd = -1;
+                  std::memcpy(&fd, CMSG_DATA(controlMessage) + i * sizeof(int), sizeof(int));
+#if defined(__APPLE__)
+                  setCloseOnExec(fd);
+#endif
+                  fds.push_back(fd);
+               }
+            }
+         }
+
+         if (numBytesReceived <= 0)
+         {
+            return false;
+         }
+
+         return receiveAll(socket, static_cast<uint8_t*>(data) + numBytesReceived, size - numBytesReceived);
+      }
+
+      void appendString(std::string& payload, std::string_view string)
+      {
+         uint32_t size = static_cast<uint32_t>(string.size());
+         payload.append(reinterpret_cast<const char*>(&size), sizeof(size));
+         payload.append(string);
+      }
+
+      std::optional<std::string> takeString(std::string_view& payload)
+      {
+         uint32_t size = 0;
+         if (payload.size() < sizeof(size))
+         {
+            return std::nullopt;
+         }
+
+         std::memcpy(&size, payload.data(), sizeof(size));
+         payload.remove_prefix(sizeof(size));
+         if (payload.size() < size)
+         {
+            return std::nullopt;
+         }
+
+         std::string string(payload.substr(0, size));
+         payload.remove_prefix(size);
+
+         return string;
+      }
+
+      int forkServerSignalFd = -1;
+
+      void onForkServerChildExited(int /* signal */)
+      {
+         int savedErrno = errno;
+         char byte = 0;
+         [[maybe_unused]] ssize_t result = write(forkServerSignalFd, &byte, 1);
+         errno = savedErrno;
+      }
+
+      // Runs in the forked server process: launches requested processes, reports when they've exited, and enforces their timeouts
+      // Single threaded, it only ever waits in poll (for requests, exited children, or the next deadline)
+      class ForkServerProcess
+      {
+      public:
+         explicit ForkServerProcess(int socket)
+            : controlSocket(socket)
+         {
+         }
+
+         void run()
+         {
+            closeUnusedDescriptors();
+
+            int signalPipe[2]{ -1, -1 };
+            if (!createPipe(signalPipe))
+            {
+               return;
+            }
+
+            for (int fd : signalPipe)
+            {
+               fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            }
+
+            forkServerSignalFd = signalPipe[1];
+
+            struct sigaction action{};
+            action.sa_handler = onForkServerChildExited;
+            action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+            sigemptyset(&action.sa_mask);
+            sigaction(SIGCHLD, &action, nullptr);
+
+            // Once our parent is gone (or done with us), so are we
+            bool running = true;
+            while (running)
+            {
+               pollfd pollFds[2]{ { controlSocket, POLLIN, 0 }, { signalPipe[0], POLLIN, 0 } };
+               if (poll(pollFds, 2, getPollTimeout(deadlineEnforcer.enforce())) < 0 && errno != EINTR)
+               {
+                  break;
+               }
+
+               if (pollFds[1].revents != 0)
+               {
+                  char buffer[64];
+                  while (read(signalPipe[0], buffer, sizeof(buffer)) > 0)
+                  {
+                  }
+               }
+
+               reapExited();
+
+               if (pollFds[0].revents != 0)
+               {
+                  running = handleRequest();
+               }
+            }
+         }
+
+      private:
+         struct Job
+         {
+            int replySocket = -1;
+            bool timedOut = false;
+         };
+
+         // Anything close-on-exec wouldn't have reached the children anyway, and the server holding it open could keep pipes (or locks) alive for our parent
+         void closeUnusedDescriptors()
+         {
+            std::vector<int> fds;
+            std::error_code errorCode;
+            for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator("/dev/fd", errorCode))
+            {
+               int fd = std::atoi(entry.path().filename().c_str());
+               int flags = fcntl(fd, F_GETFD);
+               if (fd > STDERR_FILENO && fd != controlSocket && flags != -1 && (flags & FD_CLOEXEC) != 0)
+               {
+                  fds.push_back(fd);
+               }
+            }
+
+            for (int fd : fds)
+            {
+               close(fd);
+            }
+         }
+
+         bool handleRequest()
+         {
+            ForkServerRequest request;
+            std::vector<int> fds;
+            if (!receiveWithDescriptors(controlSocket, &request, sizeof(request), fds))
+            {
+               closeAll(fds);
+               return false;
+            }
+
+            std::string payload(request.payloadSize, '\0');
+            if (!receiveAll(controlSocket, payload.data(), payload.size()) || fds.empty())
+            {
+               closeAll(fds);
+               return false;
+            }
+
+            int replySocket = fds[0];
+            StandardStreams streams;
+            std::size_t fdIndex = 1;
+            for (auto [flag, fd] : { std::pair{ kForkServerStdIn, &streams.in }, std::pair{ kForkServerStdOut, &streams.out }, std::pair{ kForkServerStdErr, &streams.err } })
+            {
+               if ((request.streamFlags & flag) != 0 && fdIndex < fds.size())
+               {
+                  *fd = fds[fdIndex++];
+               }
+            }
+
+            std::optional<pid_t> pid;
+            ProcessStartInfo startInfo;
+            if (parseRequest(request, payload, startInfo))
+            {
+               // The client has resolved the path already, and the resolver's copy here doesn't work anyway (its watcher's descriptors were closed along with everything else)
+               ExecArguments execArguments(startInfo, startInfo.path.string());
+               pid = launch(execArguments, startInfo.launchMethod, streams, startInfo.timeout.has_value());
+            }
+
+            // The child has its own copies now
+            closeStreams(streams);
+
+            ForkServerReply reply;
+            reply.pid = pid ? *pid : -1;
+            sendAll(replySocket, &reply, sizeof(reply));
+
+            if (!pid)
+            {
+               close(replySocket);
+               return true;
+            }
+
+            Job& job = jobs[*pid];
+            job.replySocket = replySocket;
+            deadlineEnforcer.add(*pid, startInfo, job.timedOut);
+
+            return true;
+         }
+
+         bool parseRequest(const ForkServerRequest& request, std::string_view payload, ProcessStartInfo& startInfo)
+         {
+            std::optional<std::string> path = takeString(payload);
+            if (!path)
+            {
+               return false;
+            }
+
+            startInfo.path = *path;
+            for (uint32_t i = 0; i < request.numArgs; ++i)
+            {
+               std::optional<std::string> arg = takeString(payload);
+               if (!arg)
+               {
+                  return false;
+               }
+
+               startInfo.args.push_back(std::move(*arg));
+            }
+
+            // Already resolved by the client (against its environment, not ours)
+            std::unordered_map<std::string, std::string> variables;
+            for (uint32_t i = 0; i < request.numEnvironmentVariables; ++i)
+            {
+               std::optional<std::string> variable = takeString(payload);
+               if (!variable)
+               {
+                  return false;
+               }
+
+               std::size_t separator = variable->find('=', 1);
+               if (separator != std::string::npos)
+               {
+                  variables.emplace(variable->substr(0, separator), variable->substr(separator + 1));
+               }
+            }
+
+            startInfo.environment = EnvironmentBlock(variables, false);
+            startInfo.launchMethod = static_cast<ProcessLaunchMethod>(request.launchMethod);
+            if (request.timeoutMilliseconds >= 0)
+            {
+               startInfo.timeout = std::chrono::milliseconds(request.timeoutMilliseconds);
+            }
+            startInfo.killGracePeriod = std::chrono::milliseconds(request.killGracePeriodMilliseconds);
+
+            return true;
+         }
+
+         void reapExited()
+         {
+            while (true)
+            {
+               siginfo_t info{};
+               if (waitid(P_ALL, 0, &info, WEXITED | WNOHANG | WNOWAIT) != 0 || info.si_pid == 0)
+               {
+                  break;
+               }
 
-      for (char** itr = environ; *itr; ++itr)
-      {
-         std::string envEntry = *itr;
-         std::size_t equalsIndex = envEntry.find('=');
-         if (equalsIndex != 0 && equalsIndex != std::string::npos)
+               pid_t pid = info.si_pid;
+               deadlineEnforcer.finish(pid);
+
+               ReapedStatus reapedStatus;
+               reap(pid, 0, reapedStatus);
+
+               auto location = jobs.find(pid);
+               if (location == jobs.end())
+               {
+                  continue;
+               }
+
+               ProcessExitInfo usage;
+               setResourceUsage(usage, reapedStatus.usage);
+
+               ForkServerReply reply;
+               reply.pid = pid;
+               reply.exited = 1;
+               reply.exitCode = reapedStatus.exitCode.value_or(-1);
+               reply.terminationSignal = reapedStatus.terminationSignal.value_or(0);
+               reply.timedOut = location->second.timedOut;
+               reply.userTimeMicroseconds = usage.userTime.count();
+               reply.systemTimeMicroseconds = usage.systemTime.count();
+               reply.peakResidentSize = usage.peakResidentSize;
+
+               sendAll(location->second.replySocket, &reply, sizeof(reply));
+               close(location->second.replySocket);
+               jobs.erase(location);
+            }
+         }
+
+         static void closeAll(const std::vector<int>& fds)
          {
-            environment.emplace(envEntry.substr(0, equalsIndex), envEntry.substr(equalsIndex + 1));
+            for (int fd : fds)
+            {
+               close(fd);
+            }
          }
-      }
 
-      return environment;
+         int controlSocket = -1;
+         std::unordered_map<pid_t, Job> jobs; // References to elements survive rehashing, so the deadline enforcer can keep pointing at timedOut
+         DeadlineEnforcer deadlineEnforcer;
+      };
    }
 
-   std::optional<ProcessExitInfo> executeProcess(ProcessStartInfo startInfo)
+   class ForkServer::Impl
    {
-      bool usePipes = startInfo.waitForExit && startInfo.readOutput;
+   public:
+      Impl()
+      {
+         int sockets[2]{ -1, -1 };
+         if (!createSocketPair(sockets))
+         {
+            return;
+         }
+
+         // Anything still buffered would otherwise be written twice (once by the server)
+         fflush(stdout);
+         fflush(stderr);
+
+         pid_t pid = fork();
+         if (pid == -1)
+         {
+            close(sockets[0]);
+            close(sockets[1]);
+            return;
+         }
+
+         if (pid == 0)
+         {
+            // Server process
 
-      int outPipe[2]{};
-      int errPipe[2]{};
-      if (usePipes)
+            close(sockets[0]);
+            ForkServerProcess(sockets[1]).run();
+            _exit(0);
+         }
+
+         close(sockets[1]);
+         controlSocket = sockets[0];
+         serverPid = pid;
+      }
+
+      ~Impl()
+      {
+         if (controlSocket != -1)
+         {
+            // The server exits once it sees the socket close
+            close(controlSocket);
+
+            std::optional<int> exitCode;
+            reap(serverPid, 0, exitCode);
+         }
+      }
+
+      bool isRunning() const
       {
-         pipe(outPipe);
-         pipe(errPipe);
+         return controlSocket != -1;
       }
 
-      pid_t pid = fork();
-      if (pid == 0)
+      std::optional<ProcessExitInfo> executeProcess(ProcessStartInfo startInfo)
       {
-         // Child process
+         if (!isRunning())
+         {
+            return OSUtils::executeProcess(std::move(startInfo));
+         }
+
+         // The path and environment are resolved here, so the child gets ours rather than the server's (which stopped changing once it was forked)
+         ExecArguments execArguments = prepareExecArguments(startInfo);
+
+         ForkServerRequest request;
+         request.numArgs = static_cast<uint32_t>(startInfo.args.size());
+         request.launchMethod = static_cast<uint32_t>(startInfo.launchMethod);
+         request.timeoutMilliseconds = startInfo.waitForExit && startInfo.timeout ? startInfo.timeout->count() : -1;
+         request.killGracePeriodMilliseconds = startInfo.killGracePeriod.count();
+
+         std::string payload;
+         appendString(payload, execArguments.path);
+         for (const std::string& arg : startInfo.args)
+         {
+            appendString(payload, arg);
+         }
+         for (char* const* variable = getEnvp(execArguments); *variable; ++variable)
+         {
+            appendString(payload, *variable);
+            ++request.numEnvironmentVariables;
+         }
+
+         // The same as runPipeline() for a single process, except for who launches it
+         std::optional<InputFeeder> inputFeeder;
+         int inputFd = -1;
+         StandardStreams streams;
+         std::vector<OutputSink> sinks;
+         ProcessExitInfo result;
+         bool streamsCreated = true;
+         if (startInfo.waitForExit && hasInputToFeed(startInfo))
+         {
+            int inPipe[2]{ -1, -1 };
+            streamsCreated &= createPipe(inPipe);
+            if (inPipe[1] != -1)
+            {
+               fcntl(inPipe[1], F_SETFL, fcntl(inPipe[1], F_GETFL) | O_NONBLOCK);
+               inputFeeder.emplace(startInfo);
+               inputFd = inPipe[1];
+            }
+            streams.in = inPipe[0];
+         }
+         else if (!startInfo.stdInPath.empty())
+         {
+            streams.in = openInputFile(startInfo.stdInPath);
+            streamsCreated &= streams.in != -1;
+         }
 
-         if (usePipes)
+         if (startInfo.waitForExit && startInfo.readOutput)
          {
-            // Redirect stdout and stderr
-            dup2(outPipe[1], STDOUT_FILENO);
-            dup2(errPipe[1], STDERR_FILENO);
+            int outPipe[2]{ -1, -1 };
+            streamsCreated &= createPipe(outPipe);
+            streams.out = outPipe[1];
+            if (outPipe[0] != -1)
+            {
+               sinks.push_back(OutputSink{ outPipe[0], &result, &startInfo, false });
+            }
 
-            close(outPipe[0]);
-            close(outPipe[1]);
-            close(errPipe[0]);
-            close(errPipe[1]);
+            int errPipe[2]{ -1, -1 };
+            streamsCreated &= createPipe(errPipe);
+            streams.err = errPipe[1];
+            if (errPipe[0] != -1)
+            {
+               sinks.push_back(OutputSink{ errPipe[0], &result, &startInfo, true });
+            }
          }
 
-         std::string pathString = startInfo.path.string();
+         int replySockets[2]{ -1, -1 };
+         streamsCreated &= createSocketPair(replySockets);
 
-         std::vector<char*> args;
-         args.reserve(startInfo.args.size() + 2);
-         args.push_back(pathString.data());
-         for (std::string& arg : startInfo.args)
+         bool sent = false;
+         std::chrono::steady_clock::time_point launchTime = std::chrono::steady_clock::now();
+         if (streamsCreated)
          {
-            args.push_back(arg.data());
+            request.streamFlags = (streams.in != -1 ? static_cast<uint32_t>(kForkServerStdIn) : 0u) | (streams.out != -1 ? static_cast<uint32_t>(kForkServerStdOut) : 0u) | (streams.err != -1 ? static_cast<uint32_t>(kForkServerStdErr) : 0u);
+            request.payloadSize = static_cast<uint32_t>(payload.size());
+
+            std::vector<int> fds{ replySockets[1] };
+            for (int fd : { streams.in, streams.out, streams.err })
+            {
+               if (fd != -1)
+               {
+                  fds.push_back(fd);
+               }
+            }
+
+            std::string message(reinterpret_cast<const char*>(&request), sizeof(request));
+            message += payload;
+
+            std::lock_guard<std::mutex> lock(sendMutex);
+            sent = sendWithDescriptors(controlSocket, message, fds);
          }
-         args.push_back(nullptr);
 
-         std::vector<std::string> envStrings;
-         if (startInfo.inheritEnvironment)
+         // The server has its own copies now (and if it never got them, the pipes just end)
+         if (replySockets[1] != -1)
          {
-            std::unordered_map<std::string, std::string> currentEnvironment = getEnvironment();
-            envStrings.reserve(currentEnvironment.size() + startInfo.env.size());
+            close(replySockets[1]);
+         }
+         closeStreams(streams);
 
-            for (const auto& [key, value] : currentEnvironment)
+         // Timeouts are enforced by the server, which ends the pipes too (by terminating whatever holds them open)
+         DeadlineEnforcer deadlineEnforcer;
+         exchangeData(inputFeeder, inputFd, sinks, deadlineEnforcer);
+
+         std::optional<ProcessExitInfo> exitInfo;
+         ForkServerReply reply;
+         while (sent && startInfo.waitForExit && receiveAll(replySockets[0], &reply, sizeof(reply)) && reply.pid != -1)
+         {
+            if (reply.exited != 0)
             {
-               if (startInfo.env.count(key) == 0) // Provided environment variables take precedence
+               if (reply.exitCode != -1 || reply.terminationSignal != 0)
                {
-                  envStrings.push_back(key + "=" + value);
+                  ProcessExitInfo& exitInfoRef = exitInfo.emplace(std::move(result));
+                  exitInfoRef.exitCode = reply.exitCode != -1 ? reply.exitCode : 128 + reply.terminationSignal;
+                  if (reply.terminationSignal != 0)
+                  {
+                     exitInfoRef.terminationSignal = reply.terminationSignal;
+                  }
+                  exitInfoRef.timedOut = reply.timedOut != 0;
+                  exitInfoRef.wallTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - launchTime);
+                  exitInfoRef.userTime = std::chrono::microseconds(reply.userTimeMicroseconds);
+                  exitInfoRef.systemTime = std::chrono::microseconds(reply.systemTimeMicroseconds);
+                  exitInfoRef.peakResidentSize = reply.peakResidentSize;
                }
+
+               break;
+            }
+         }
+
+         if (replySockets[0] != -1)
+         {
+            close(replySockets[0]);
+         }
+
+         return exitInfo;
+      }
+
+   private:
+      int controlSocket = -1;
+      pid_t serverPid = -1;
+      std::mutex sendMutex; // Requests from different threads mustn't interleave
+   };
+
+   ForkServer::ForkServer()
+      : impl(std::make_unique<Impl>())
+   {
+   }
+
+   ForkServer::~ForkServer()
+   {
+   }
+
+   bool ForkServer::isRunning() const
+   {
+      return impl->isRunning();
+   }
+
+   std::optional<ProcessExitInfo> ForkServer::executeProcess(ProcessStartInfo startInfo)
+   {
+      return impl->executeProcess(std::move(startInfo));
+   }
+
+   std::optional<FileInfo> getFileInfo(const std::filesystem::path& path)
+   {
+      struct stat fileStat{};
+      if (stat(path.c_str(), &fileStat) != 0)
+      {
+         return std::nullopt;
+      }
+
+#if defined(__APPLE__)
+      const timespec& modificationTime = fileStat.st_mtimespec;
+#else
+      const timespec& modificationTime = fileStat.st_mtim;
+#endif
+
+      FileInfo info;
+      info.device = static_cast<uint64_t>(fileStat.st_dev);
+      info.inode = static_cast<uint64_t>(fileStat.st_ino);
+      info.size = static_cast<uint64_t>(fileStat.st_size);
+      info.modificationTime = static_cast<int64_t>(modificationTime.tv_sec) * 1'000'000'000 + modificationTime.tv_nsec;
+
+      return info;
+   }
+
+   std::optional<MappedFile> mapFile(const std::filesystem::path& path, const MapFileOptions& options)
+   {
+      int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0)
+      {
+         return std::nullopt;
+      }
+
+      struct stat fileStat{};
+      if (fstat(fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode) || fileStat.st_size <= 0)
+      {
+         close(fd);
+         return std::nullopt;
+      }
+
+      std::size_t size = static_cast<std::size_t>(fileStat.st_size);
+
+      int flags = MAP_PRIVATE;
+#if defined(MAP_POPULATE)
+      if (options.prefetch)
+      {
+         flags |= MAP_POPULATE;
+      }
+#endif
+
+      void* data = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+      close(fd); // The mapping keeps its own reference to the file
+
+      if (data == MAP_FAILED)
+      {
+         return std::nullopt;
+      }
+
+      if (options.accessPattern == FileAccessPattern::Sequential)
+      {
+         posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+      }
+      else if (options.accessPattern == FileAccessPattern::Random)
+      {
+         posix_madvise(data, size, POSIX_MADV_RANDOM);
+      }
+
+#if !defined(MAP_POPULATE)
+      if (options.prefetch)
+      {
+         posix_madvise(data, size, POSIX_MADV_WILLNEED);
+      }
+#endif
+
+      return MappedFile(static_cast<const uint8_t*>(data), size);
+   }
+
+   void MappedFile::unmap()
+   {
+      if (data)
+      {
+         munmap(const_cast<uint8_t*>(data), size);
+
+         data = nullptr;
+         size = 0;
+      }
+   }
+
+   std::optional<File> openFile(const std::filesystem::path& path, FileOpenMode mode, FileAccessPattern accessPattern)
+   {
+      int flags = O_CLOEXEC;
+      switch (mode)
+      {
+      case FileOpenMode::Read:
+         flags |= O_RDONLY | O_NONBLOCK; // Don't block when opening FIFOs, cleared below
+         break;
+      case FileOpenMode::Write:
+         flags |= O_WRONLY | O_CREAT | O_TRUNC;
+         break;
+      case FileOpenMode::Append:
+         flags |= O_WRONLY | O_CREAT | O_APPEND;
+         break;
+      default:
+         return std::nullopt;
+      }
+
+      int fd = open(path.c_str(), flags, 0666);
+      if (fd < 0)
+      {
+         return std::nullopt;
+      }
+
+      if (mode == FileOpenMode::Read)
+      {
+         struct stat fileStat{};
+         if (fstat(fd, &fileStat) == 0 && !S_ISREG(fileStat.st_mode))
+         {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+         }
+      }
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+      if (accessPattern == FileAccessPattern::Sequential)
+      {
+         posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+      }
+      else if (accessPattern == FileAccessPattern::Random)
+      {
+         posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+      }
+#endif
+
+      return File(fd);
+   }
+
+   std::optional<uint64_t> File::getSize() const
+   {
+      struct stat fileStat{};
+      if (isOpen() && fstat(static_cast<int>(handle), &fileStat) == 0 && S_ISREG(fileStat.st_mode))
+      {
+         return static_cast<uint64_t>(fileStat.st_size);
+      }
+
+      return std::nullopt;
+   }
+
+   std::optional<std::size_t> File::read(std::span<uint8_t> buffer)
+   {
+      std::size_t numBytesRead = 0;
+      while (numBytesRead < buffer.size())
+      {
+         ssize_t result = ::read(static_cast<int>(handle), buffer.data() + numBytesRead, buffer.size() - numBytesRead);
+         if (result < 0)
+         {
+            if (errno == EINTR)
+            {
+               continue;
             }
+
+            return std::nullopt;
+         }
+
+         if (result == 0)
+         {
+            break;
          }
-         else
+
+         numBytesRead += static_cast<std::size_t>(result);
+      }
+
+      return numBytesRead;
+   }
+
+   bool File::write(std::span<const uint8_t> data)
+   {
+      std::size_t numBytesWritten = 0;
+      while (numBytesWritten < data.size())
+      {
+         ssize_t result = ::write(static_cast<int>(handle), data.data() + numBytesWritten, data.size() - numBytesWritten);
+         if (result < 0)
          {
-            envStrings.reserve(startInfo.env.size());
+            if (errno == EINTR)
+            {
+               continue;
+            }
+
+            return false;
          }
 
-         for (const auto& [key, value] : startInfo.env)
+         numBytesWritten += static_cast<std::size_t>(result);
+      }
+
+      return true;
+   }
+
+   bool File::write(std::span<const std::span<const uint8_t>> fragments)
+   {
+      static const std::size_t kMaxFragmentsPerCall = IOV_MAX < 1024 ? IOV_MAX : 1024;
+
+      std::array<iovec, kMaxFragmentsPerCall> vectors{};
+      std::size_t fragmentIndex = 0;
+      std::size_t fragmentOffset = 0; // Within fragments[fragmentIndex], after partial writes
+
+      while (fragmentIndex < fragments.size())
+      {
+         std::size_t numVectors = 0;
+         for (std::size_t i = fragmentIndex; i < fragments.size() && numVectors < vectors.size(); ++i)
          {
-            envStrings.push_back(key + "=" + value);
+            std::size_t offset = i == fragmentIndex ? fragmentOffset : 0;
+            vectors[numVectors].iov_base = const_cast<uint8_t*>(fragments[i].data() + offset);
+            vectors[numVectors].iov_len = fragments[i].size() - offset;
+            ++numVectors;
          }
 
-         std::vector<char*> env;
-         if (!envStrings.empty())
+         ssize_t result = ::writev(static_cast<int>(handle), vectors.data(), static_cast<int>(numVectors));
+         if (result < 0)
          {
-            env.reserve(envStrings.size() + 1);
-            for (std::string& envString : envStrings)
+            if (errno == EINTR)
             {
-               env.push_back(envString.data());
+               continue;
             }
-            env.push_back(nullptr);
+
+            return false;
          }
 
-         fflush(stdout);
-         fflush(stderr);
+         // Skip past everything that was written
+         std::size_t numBytesWritten = static_cast<std::size_t>(result);
+         while (fragmentIndex < fragments.size() && numBytesWritten >= fragments[fragmentIndex].size() - fragmentOffset)
+         {
+            numBytesWritten -= fragments[fragmentIndex].size() - fragmentOffset;
+            fragmentOffset = 0;
+            ++fragmentIndex;
+         }
+         fragmentOffset += numBytesWritten;
+      }
+
+      return true;
+   }
 
-         const char* file = pathString.c_str();
-         char* const* argv = args.data();
-         char* const* envp = env.empty() ? nullptr : env.data();
+   bool File::writeAt(uint64_t offset, std::span<const uint8_t> data)
+   {
+      std::size_t numBytesWritten = 0;
+      while (numBytesWritten < data.size())
+      {
+         ssize_t result = ::pwrite(static_cast<int>(handle), data.data() + numBytesWritten, data.size() - numBytesWritten, static_cast<off_t>(offset + numBytesWritten));
+         if (result < 0)
+         {
+            if (errno == EINTR)
+            {
+               continue;
+            }
 
-         execve(file, argv, envp);
+            return false;
+         }
 
-         int error = errno;
-         fprintf(stderr, "Exec failed with errno = %d (%s)", error, strerror(error));
-         abort();
+         numBytesWritten += static_cast<std::size_t>(result);
       }
 
-      // Parent process
+      return true;
+   }
 
-      if (usePipes)
+   bool File::sync()
+   {
+#if defined(F_FULLFSYNC)
+      // fsync() on macOS only pushes data to the drive, not through its cache
+      if (fcntl(static_cast<int>(handle), F_FULLFSYNC) == 0)
       {
-         close(outPipe[1]);
-         close(errPipe[1]);
+         return true;
       }
+#endif
 
-      std::optional<ProcessExitInfo> exitInfo;
-      if (startInfo.waitForExit)
+      return fsync(static_cast<int>(handle)) == 0;
+   }
+
+   bool File::setPermissions(std::filesystem::perms permissions)
+   {
+      return fchmod(static_cast<int>(handle), static_cast<mode_t>(permissions & std::filesystem::perms::mask)) == 0;
+   }
+
+   void File::close()
+   {
+      if (isOpen())
       {
-         int status = 0;
-         waitpid(pid, &status, 0);
+         ::close(static_cast<int>(handle));
+         handle = kInvalidHandle;
+      }
+
+      if (!temporaryPath.empty())
+      {
+         unlink(temporaryPath.c_str());
+         temporaryPath.clear();
+      }
+   }
+
+   std::optional<File> createTemporaryFile(const std::filesystem::path& directory)
+   {
+      std::filesystem::path directoryPath = getDirectoryPath(directory);
+
+#if defined(O_TMPFILE)
+      // Anonymous files disappear on their own if never committed (not supported by all filesystems)
+      // Readable too, so they can still be copied to a named file if linking them fails
+      if (canLinkAnonymousFiles())
+      {
+         int anonymousFd = open(directoryPath.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0666);
+         if (anonymousFd >= 0)
+         {
+            return File(anonymousFd);
+         }
+      }
+#endif
+
+      std::filesystem::path temporaryPath;
+      int fd = openNamedTemporaryFile(directoryPath, temporaryPath);
+      if (fd < 0)
+      {
+         return std::nullopt;
+      }
+
+      return File(fd, std::move(temporaryPath));
+   }
+
+   bool commitTemporaryFile(File& file, const std::filesystem::path& path)
+   {
+      if (!file.isOpen())
+      {
+         return false;
+      }
 
-         if (WIFEXITED(status))
+      if (!file.temporaryPath.empty())
+      {
+         if (rename(file.temporaryPath.c_str(), path.c_str()) != 0)
          {
-            exitInfo = ProcessExitInfo{};
-            exitInfo->exitCode = WEXITSTATUS(status);
+            return false;
          }
+
+         file.temporaryPath.clear();
+         return true;
+      }
+
+      // Anonymous file, link it into the directory
+      std::string procPath = "/proc/self/fd/" + std::to_string(file.getNativeHandle());
+      if (linkat(AT_FDCWD, procPath.c_str(), AT_FDCWD, path.c_str(), AT_SYMLINK_FOLLOW) == 0)
+      {
+         return true;
       }
 
-      if (usePipes)
+      if (errno == ENOENT)
       {
-         if (exitInfo)
+         // /proc went away since the file was created, copy it to a named file (synced, since it may have been synced already) and commit that instead
+         std::filesystem::path temporaryPath;
+         int fd = openNamedTemporaryFile(getDirectoryPath(path.parent_path()), temporaryPath);
+         if (fd < 0)
+         {
+            return false;
+         }
+
+         File namedFile(fd, std::move(temporaryPath));
+
+         struct stat status;
+         bool copied = fstat(static_cast<int>(file.handle), &status) == 0 && fchmod(fd, status.st_mode & 07777) == 0;
+         if (!copied || !copyFileContents(file, namedFile, static_cast<uint64_t>(status.st_size)) || !namedFile.sync())
          {
-            struct stat outStat{};
-            struct stat errStat{};
+            return false;
+         }
+
+         file = std::move(namedFile);
+         return commitTemporaryFile(file, path);
+      }
+
+      if (errno != EEXIST)
+      {
+         return false;
+      }
 
-            fstat(outPipe[0], &outStat);
-            fstat(errPipe[0], &errStat);
+      // linkat() won't replace an existing file, so link it under a temporary name and rename that over the destination
+      static const int kMaxAttempts = 16;
+      for (int i = 0; i < kMaxAttempts; ++i)
+      {
+         std::filesystem::path temporaryPath = getDirectoryPath(path.parent_path()) / makeTemporaryFileName();
+         if (linkat(AT_FDCWD, procPath.c_str(), AT_FDCWD, temporaryPath.c_str(), AT_SYMLINK_FOLLOW) == 0)
+         {
+            if (rename(temporaryPath.c_str(), path.c_str()) == 0)
+            {
+               return true;
+            }
 
-            exitInfo->stdOut.resize(outStat.st_size);
-            read(outPipe[0], exitInfo->stdOut.data(), outStat.st_size);
+            unlink(temporaryPath.c_str());
+            return false;
+         }
 
-            exitInfo->stdErr.resize(errStat.st_size);
-            read(errPipe[0], exitInfo->stdErr.data(), errStat.st_size);
+         if (errno != EEXIST)
+         {
+            break;
          }
+      }
+
+      return false;
+   }
 
-         close(outPipe[0]);
-         close(errPipe[0]);
+   bool syncDirectory(const std::filesystem::path& directory)
+   {
+      int fd = open(getDirectoryPath(directory).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (fd < 0)
+      {
+         return false;
       }
 
-      return exitInfo;
+      bool synced = fsync(fd) == 0;
+      ::close(fd);
+
+      return synced;
    }
 }
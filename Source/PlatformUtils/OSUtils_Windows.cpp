@@ -1,9 +1,17 @@
 #include "PlatformUtils/OSUtils.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <bit>
+#include <cwchar>
+#include <chrono>
 #include <limits>
+#include <mutex>
+#include <span>
 #include <sstream>
+#include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -18,8 +26,16 @@
 #include <ShlObj.h>
 #include <Windows.h>
 
+#include <Psapi.h>
+
 namespace OSUtils
 {
+   // Implemented in ExecutableResolver.cpp
+   std::filesystem::path resolveExecutablePath(const std::filesystem::path& path); // Bare names are looked up on PATH
+
+   // Implemented in OSUtils_Common.cpp
+   void appendProcessOutput(std::string& output, std::string_view data, const ProcessOutputFunction& function, std::optional<std::size_t> maxOutputSize, bool& truncated);
+
    namespace
    {
       std::string wstringToString(const std::wstring& wstring)
@@ -30,246 +46,1377 @@ namespace OSUtils
          std::string string(numBytes, '\0');
          WideCharToMultiByte(CP_UTF8, 0, wstring.c_str(), numWideChars, string.data(), numBytes, nullptr, nullptr);
 
-         return string;
+         return string;
+      }
+
+      std::wstring stringToWstring(const std::string& string)
+      {
+         int numBytes = string.size() <= static_cast<size_t>(std::numeric_limits<int>::max()) ? static_cast<int>(string.size()) : -1;
+         int numWideChars = MultiByteToWideChar(CP_UTF8, 0, string.c_str(), numBytes, nullptr, 0);
+
+         std::wstring wstring(numWideChars, L'\0');
+         MultiByteToWideChar(CP_UTF8, 0, string.c_str(), numBytes, wstring.data(), numWideChars);
+
+         return wstring;
+      }
+
+      // Reads until the pipe is closed (by the child exiting), with the lock held only while passing the data on
+      void drainPipe(HANDLE handle, std::string& output, const ProcessOutputFunction& function, const ProcessStartInfo& startInfo, bool& truncated, std::mutex& outputMutex)
+      {
+         static const DWORD kBufferSize = 64 * 1024;
+
+         std::vector<char> buffer(kBufferSize);
+         DWORD numBytesRead = 0;
+         while (ReadFile(handle, buffer.data(), kBufferSize, &numBytesRead, nullptr) && numBytesRead > 0)
+         {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            appendProcessOutput(output, std::string_view(buffer.data(), numBytesRead), function, startInfo.maxOutputSize, truncated);
+         }
+      }
+   }
+
+   std::optional<std::filesystem::path> computeExecutablePath()
+   {
+      WCHAR buffer[MAX_PATH + 1];
+      DWORD length = GetModuleFileNameW(nullptr, buffer, MAX_PATH);
+      buffer[length] = '\0';
+
+      if (length == 0 || length == MAX_PATH || GetLastError() == ERROR_INSUFFICIENT_BUFFER)
+      {
+         static const DWORD kUnreasonablyLargeStringLength = 32767;
+         std::vector<WCHAR> unreasonablyLargeBuffer(kUnreasonablyLargeStringLength + 1);
+         length = GetModuleFileNameW(nullptr, unreasonablyLargeBuffer.data(), kUnreasonablyLargeStringLength);
+         unreasonablyLargeBuffer[length] = '\0';
+
+         if (length != 0 && length != kUnreasonablyLargeStringLength && GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+         {
+            return std::filesystem::path(unreasonablyLargeBuffer.data());
+         }
+      }
+      else
+      {
+         return std::filesystem::path(buffer);
+      }
+
+      return std::nullopt;
+   }
+
+   std::optional<std::filesystem::path> computeKnownDirectoryPath(KnownDirectory knownDirectory)
+   {
+      const KNOWNFOLDERID* folderID = nullptr;
+      switch (knownDirectory)
+      {
+      case KnownDirectory::Home:
+         folderID = &FOLDERID_Profile;
+         break;
+      case KnownDirectory::Desktop:
+         folderID = &FOLDERID_Desktop;
+         break;
+      case KnownDirectory::Downloads:
+         folderID = &FOLDERID_Downloads;
+         break;
+      case KnownDirectory::UserApplications:
+         folderID = &FOLDERID_UserProgramFiles;
+         break;
+      case KnownDirectory::CommonApplications:
+         folderID = &FOLDERID_ProgramFiles;
+         break;
+      case KnownDirectory::UserApplicationData:
+         folderID = &FOLDERID_LocalAppData;
+         break;
+      case KnownDirectory::CommonApplicationData:
+         folderID = &FOLDERID_ProgramData;
+         break;
+      default:
+         break;
+      }
+
+      if (folderID == nullptr)
+      {
+         return std::nullopt;
+      }
+
+      std::optional<std::filesystem::path> knownDirectoryPath;
+      PWSTR path = nullptr;
+      if (SHGetKnownFolderPath(*folderID, KF_FLAG_DEFAULT, nullptr, &path) == S_OK)
+      {
+         knownDirectoryPath = std::filesystem::path(path);
+      }
+      CoTaskMemFree(path);
+
+      return knownDirectoryPath;
+   }
+
+   class EnvironmentBlock::Impl
+   {
+   public:
+      Impl(const std::unordered_map<std::string, std::string>& overrides, bool inheritEnvironment)
+      {
+         if (inheritEnvironment)
+         {
+            if (LPWCH environmentStrings = GetEnvironmentStringsW())
+            {
+               for (LPWCH itr = environmentStrings; *itr != L'\0'; itr += std::wcslen(itr) + 1)
+               {
+                  std::wstring_view envEntry = itr;
+                  std::size_t equalsIndex = envEntry.find(L'=');
+                  if (equalsIndex != 0 && equalsIndex != std::wstring_view::npos && overrides.count(wstringToString(std::wstring(envEntry.substr(0, equalsIndex)))) == 0) // Provided environment variables take precedence
+                  {
+                     block.append(envEntry);
+                     block += L'\0';
+                     ++numVariables;
+                  }
+               }
+
+               FreeEnvironmentStringsW(environmentStrings);
+            }
+         }
+
+         for (const auto& [key, value] : overrides)
+         {
+            block += stringToWstring(key);
+            block += L'=';
+            block += stringToWstring(value);
+            block += L'\0';
+            ++numVariables;
+         }
+
+         // The block ends with an empty string (the wstring's own terminator makes the second null)
+         block += L'\0';
+      }
+
+      std::size_t getNumVariables() const
+      {
+         return numVariables;
+      }
+
+      const void* getNativeBlock() const
+      {
+         return block.c_str();
+      }
+
+   private:
+      std::wstring block;
+      std::size_t numVariables = 0;
+   };
+
+   EnvironmentBlock::EnvironmentBlock(const std::unordered_map<std::string, std::string>& overrides, bool inheritEnvironment)
+      : impl(std::make_shared<const Impl>(overrides, inheritEnvironment))
+   {
+   }
+
+   std::size_t EnvironmentBlock::getNumVariables() const
+   {
+      return impl->getNumVariables();
+   }
+
+   const void* EnvironmentBlock::getNativeBlock() const
+   {
+      return impl->getNativeBlock();
+   }
+
+   std::unordered_map<std::string, std::string> getEnvironment()
+   {
+      std::unordered_map<std::string, std::string> environment;
+
+      if (LPWCH environmentStrings = GetEnvironmentStringsW())
+      {
+         LPWCH itr = environmentStrings;
+         while (*itr)
+         {
+            std::wstring envEntry = itr;
+            std::size_t equalsIndex = envEntry.find('=');
+            if (equalsIndex != 0 && equalsIndex != std::wstring::npos)
+            {
+               std::wstring key = envEntry.substr(0, equalsIndex);
+               std::wstring value = envEntry.substr(equalsIndex + 1);
+               environment.emplace(wstringToString(key), wstringToString(value));
+            }
+
+            itr += envEntry.size() + 1;
+         }
+
+         FreeEnvironmentStringsW(environmentStrings);
+      }
+
+      return environment;
+   }
+
+   namespace
+   {
+      std::wstring buildCommandLine(const ProcessStartInfo& startInfo)
+      {
+         std::wstringstream commandLineStream;
+         commandLineStream << L'\"' << startInfo.path.wstring() << L'\"';
+         for (const std::string& arg : startInfo.args)
+         {
+            commandLineStream << L" \"" << stringToWstring(arg) << L'\"';
+         }
+
+         return commandLineStream.str();
+      }
+
+      EnvironmentBlock getEnvironmentBlock(const ProcessStartInfo& startInfo)
+      {
+         return startInfo.environment ? *startInfo.environment : EnvironmentBlock(startInfo.env, startInfo.inheritEnvironment);
+      }
+
+      DWORD getTimeoutMilliseconds(std::chrono::steady_clock::duration duration)
+      {
+         int64_t milliseconds = std::chrono::ceil<std::chrono::milliseconds>(duration).count();
+         return static_cast<DWORD>(std::clamp<int64_t>(milliseconds, 0, INFINITE - 1));
+      }
+
+      // Both ends are inheritable, the end we keep is made non-inheritable by the caller
+      bool createPipe(HANDLE& readHandle, HANDLE& writeHandle)
+      {
+         SECURITY_ATTRIBUTES securityAttributes{};
+         securityAttributes.nLength = sizeof(securityAttributes);
+         securityAttributes.bInheritHandle = true;
+
+         return CreatePipe(&readHandle, &writeHandle, &securityAttributes, 0);
+      }
+
+      void keepForSelf(HANDLE handle)
+      {
+         SetHandleInformation(handle, HANDLE_FLAG_INHERIT, 0);
+      }
+
+      HANDLE openInputFile(const std::filesystem::path& path)
+      {
+         SECURITY_ATTRIBUTES securityAttributes{};
+         securityAttributes.nLength = sizeof(securityAttributes);
+         securityAttributes.bInheritHandle = true;
+
+         HANDLE handle = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, &securityAttributes, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+         return handle != INVALID_HANDLE_VALUE ? handle : nullptr;
+      }
+
+      bool hasInputToFeed(const ProcessStartInfo& startInfo)
+      {
+         return startInfo.stdInFunction || startInfo.stdInData;
+      }
+
+      // Writes stdInData / stdInFunction's output to the child's stdin, then closes the pipe to tell it that's the end
+      void feedInput(HANDLE handle, const ProcessStartInfo& startInfo)
+      {
+         static const std::size_t kBufferSize = 64 * 1024;
+
+         // Fails once the child stops reading (closes its end)
+         auto writeAll = [handle](std::string_view data)
+         {
+            while (!data.empty())
+            {
+               DWORD numBytesWritten = 0;
+               DWORD numBytesToWrite = static_cast<DWORD>(std::min<std::size_t>(data.size(), kBufferSize));
+               if (!WriteFile(handle, data.data(), numBytesToWrite, &numBytesWritten, nullptr))
+               {
+                  return false;
+               }
+
+               data.remove_prefix(numBytesWritten);
+            }
+
+            return true;
+         };
+
+         if (startInfo.stdInFunction)
+         {
+            std::vector<char> buffer(kBufferSize);
+            while (true)
+            {
+               std::size_t size = std::min(startInfo.stdInFunction(std::span<char>(buffer)), buffer.size());
+               if (size == 0 || !writeAll(std::string_view(buffer.data(), size)))
+               {
+                  break;
+               }
+            }
+         }
+         else if (startInfo.stdInData)
+         {
+            writeAll(*startInfo.stdInData);
+         }
+
+         CloseHandle(handle);
+      }
+
+      // Standard handles that aren't given (nullptr) are the same as ours
+      // Only these handles are inherited (rather than every inheritable handle we have), so one child can't keep another's pipes open
+      // If a job is given, the process is started in it (before it can run, so everything it starts is in the job too)
+      std::optional<PROCESS_INFORMATION> launch(const ProcessStartInfo& startInfo, HANDLE stdIn, HANDLE stdOut, HANDLE stdErr, HANDLE job = nullptr)
+      {
+         std::wstring pathString = resolveExecutablePath(startInfo.path).wstring(); // CreateProcess doesn't search for it itself when given the application name
+         std::wstring commandLine = buildCommandLine(startInfo);
+         EnvironmentBlock environment = getEnvironmentBlock(startInfo);
+
+         STARTUPINFOEXW startupInfo{};
+         startupInfo.StartupInfo.cb = sizeof(startupInfo);
+
+         std::vector<HANDLE> inheritedHandles;
+         std::vector<HANDLE> duplicatedHandles;
+         if (stdIn || stdOut || stdErr)
+         {
+            auto getStandardHandle = [&](HANDLE handle, DWORD standardHandleId) -> HANDLE
+            {
+               if (!handle)
+               {
+                  // Ours might not be inheritable, so the child gets a copy that is
+                  HANDLE ownHandle = GetStdHandle(standardHandleId);
+                  if (!ownHandle || ownHandle == INVALID_HANDLE_VALUE || !DuplicateHandle(GetCurrentProcess(), ownHandle, GetCurrentProcess(), &handle, 0, true, DUPLICATE_SAME_ACCESS))
+                  {
+                     return nullptr;
+                  }
+
+                  duplicatedHandles.push_back(handle);
+               }
+
+               if (std::find(inheritedHandles.begin(), inheritedHandles.end(), handle) == inheritedHandles.end())
+               {
+                  inheritedHandles.push_back(handle);
+               }
+
+               return handle;
+            };
+
+            startupInfo.StartupInfo.dwFlags |= STARTF_USESTDHANDLES;
+            startupInfo.StartupInfo.hStdInput = getStandardHandle(stdIn, STD_INPUT_HANDLE);
+            startupInfo.StartupInfo.hStdOutput = getStandardHandle(stdOut, STD_OUTPUT_HANDLE);
+            startupInfo.StartupInfo.hStdError = getStandardHandle(stdErr, STD_ERROR_HANDLE);
+         }
+
+         std::vector<uint8_t> attributeListStorage;
+         if (!inheritedHandles.empty())
+         {
+            SIZE_T attributeListSize = 0;
+            InitializeProcThreadAttributeList(nullptr, 1, 0, &attributeListSize);
+            attributeListStorage.resize(attributeListSize);
+
+            LPPROC_THREAD_ATTRIBUTE_LIST attributeList = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attributeListStorage.data());
+            if (InitializeProcThreadAttributeList(attributeList, 1, 0, &attributeListSize))
+            {
+               if (UpdateProcThreadAttribute(attributeList, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, inheritedHandles.data(), inheritedHandles.size() * sizeof(HANDLE), nullptr, nullptr))
+               {
+                  startupInfo.lpAttributeList = attributeList;
+               }
+               else
+               {
+                  DeleteProcThreadAttributeList(attributeList);
+               }
+            }
+         }
+
+         DWORD creationFlags = CREATE_UNICODE_ENVIRONMENT | DETACHED_PROCESS | (startupInfo.lpAttributeList ? EXTENDED_STARTUPINFO_PRESENT : 0) | (job ? CREATE_SUSPENDED : 0);
+
+         PROCESS_INFORMATION processInformation{};
+         bool processCreated = CreateProcessW(pathString.c_str(), commandLine.data(), nullptr, nullptr, startupInfo.lpAttributeList != nullptr, creationFlags, const_cast<void*>(environment.getNativeBlock()), nullptr, &startupInfo.StartupInfo, &processInformation);
+
+         if (startupInfo.lpAttributeList)
+         {
+            DeleteProcThreadAttributeList(startupInfo.lpAttributeList);
+         }
+         for (HANDLE handle : duplicatedHandles)
+         {
+            CloseHandle(handle);
+         }
+
+         if (!processCreated)
+         {
+            return std::nullopt;
+         }
+
+         if (job)
+         {
+            AssignProcessToJobObject(job, processInformation.hProcess);
+            ResumeThread(processInformation.hThread);
+         }
+
+         return processInformation;
+      }
+
+      std::chrono::microseconds toMicroseconds(const FILETIME& fileTime)
+      {
+         uint64_t ticks = (static_cast<uint64_t>(fileTime.dwHighDateTime) << 32) | fileTime.dwLowDateTime;
+         return std::chrono::microseconds(ticks / 10); // In units of 100 ns
+      }
+
+      void setResourceUsage(ProcessExitInfo& exitInfo, HANDLE process)
+      {
+         FILETIME creationTime{};
+         FILETIME exitTime{};
+         FILETIME kernelTime{};
+         FILETIME userTime{};
+         if (GetProcessTimes(process, &creationTime, &exitTime, &kernelTime, &userTime))
+         {
+            exitInfo.wallTime = toMicroseconds(exitTime) - toMicroseconds(creationTime);
+            exitInfo.userTime = toMicroseconds(userTime);
+            exitInfo.systemTime = toMicroseconds(kernelTime);
+         }
+
+         PROCESS_MEMORY_COUNTERS memoryCounters{};
+         if (GetProcessMemoryInfo(process, &memoryCounters, sizeof(memoryCounters)))
+         {
+            exitInfo.peakResidentSize = memoryCounters.PeakWorkingSetSize;
+         }
+      }
+
+      // Launches the processes with each one's stdout connected to the next one's stdin, exchanges data with them while they run, then waits for all of them
+      // Every pipe gets its own thread, so nothing can block on a full pipe while we're busy with another one
+      std::vector<std::optional<ProcessExitInfo>> runPipeline(const std::vector<ProcessStartInfo>& startInfos)
+      {
+         std::size_t numProcesses = startInfos.size();
+         std::vector<std::optional<ProcessExitInfo>> exitInfos(numProcesses);
+         if (numProcesses == 0)
+         {
+            return exitInfos;
+         }
+
+         const ProcessStartInfo& firstStartInfo = startInfos.front();
+         HANDLE inputWrite = nullptr;
+         HANDLE nextIn = nullptr;
+         if (hasInputToFeed(firstStartInfo))
+         {
+            if (!createPipe(nextIn, inputWrite))
+            {
+               return exitInfos;
+            }
+
+            keepForSelf(inputWrite);
+         }
+         else if (!firstStartInfo.stdInPath.empty())
+         {
+            nextIn = openInputFile(firstStartInfo.stdInPath);
+            if (!nextIn)
+            {
+               return exitInfos;
+            }
+         }
+
+         std::vector<ProcessExitInfo> results(numProcesses);
+         std::vector<std::optional<PROCESS_INFORMATION>> processes(numProcesses);
+         std::vector<HANDLE> jobs(numProcesses, nullptr);
+         std::vector<std::chrono::steady_clock::time_point> deadlines(numProcesses);
+         std::vector<std::thread> threads;
+         std::mutex outputMutex;
+
+         // Set once every pipe has been drained, which can take longer than the processes themselves (if they left something running that still has them open)
+         // Starts at one until everything's launched, so it can't reach zero too soon
+         HANDLE drainedEvent = CreateEventW(nullptr, true, false, nullptr);
+         std::atomic<std::size_t> numDraining = 1;
+         auto finishDraining = [&]()
+         {
+            if (--numDraining == 0 && drainedEvent)
+            {
+               SetEvent(drainedEvent);
+            }
+         };
+
+         auto startDraining = [&](HANDLE readHandle, std::size_t index, bool isStdErr)
+         {
+            keepForSelf(readHandle);
+            ++numDraining;
+            threads.emplace_back([&, readHandle, index, isStdErr]()
+            {
+               const ProcessStartInfo& startInfo = startInfos[index];
+               ProcessExitInfo& result = results[index];
+               drainPipe(readHandle, isStdErr ? result.stdErr : result.stdOut, isStdErr ? startInfo.stdErrFunction : startInfo.stdOutFunction, startInfo, result.outputTruncated, outputMutex);
+               CloseHandle(readHandle);
+               finishDraining();
+            });
+         };
+
+         for (std::size_t i = 0; i < numProcesses; ++i)
+         {
+            const ProcessStartInfo& startInfo = startInfos[i];
+            bool isLast = i + 1 == numProcesses;
+
+            HANDLE stdIn = std::exchange(nextIn, nullptr);
+            HANDLE stdOut = nullptr;
+            HANDLE stdErr = nullptr;
+
+            bool pipesCreated = true;
+            if (!isLast || startInfo.readOutput)
+            {
+               HANDLE outRead = nullptr;
+               pipesCreated &= createPipe(outRead, stdOut);
+
+               if (!isLast)
+               {
+                  nextIn = outRead;
+               }
+               else if (outRead)
+               {
+                  startDraining(outRead, i, false);
+               }
+            }
+
+            if (startInfo.readOutput)
+            {
+               HANDLE errRead = nullptr;
+               pipesCreated &= createPipe(errRead, stdErr);
+
+               if (errRead)
+               {
+                  startDraining(errRead, i, true);
+               }
+            }
+
+            if (pipesCreated)
+            {
+               // With a timeout, it gets its own job, so that everything it starts can be terminated with it
+               if (startInfo.timeout)
+               {
+                  jobs[i] = CreateJobObjectW(nullptr, nullptr);
+                  deadlines[i] = std::chrono::steady_clock::now() + *startInfo.timeout;
+               }
+
+               processes[i] = launch(startInfo, stdIn, stdOut, stdErr, jobs[i]);
+            }
+
+            // The child has its own copies now (and if it couldn't be launched, its neighbours see the end of their pipes)
+            for (HANDLE handle : { stdIn, stdOut, stdErr })
+            {
+               if (handle)
+               {
+                  CloseHandle(handle);
+               }
+            }
+         }
+
+         if (inputWrite)
+         {
+            threads.emplace_back([&firstStartInfo, inputWrite]() { feedInput(inputWrite, firstStartInfo); });
+         }
+
+         finishDraining();
+
+         // Waits for all of the processes to exit and all of the pipes to be drained, terminating jobs as their deadlines pass
+         static const UINT kTerminatedExitCode = 1;
+         std::vector<bool> exited(numProcesses, false);
+         std::vector<bool> terminated(numProcesses, false);
+         bool drained = !drainedEvent;
+         while (true)
+         {
+            std::vector<HANDLE> waitHandles;
+            std::vector<std::size_t> waitIndices;
+            for (std::size_t i = 0; i < numProcesses && waitHandles.size() + 1 < MAXIMUM_WAIT_OBJECTS; ++i)
+            {
+               if (processes[i] && !exited[i])
+               {
+                  waitHandles.push_back(processes[i]->hProcess);
+                  waitIndices.push_back(i);
+               }
+            }
+
+            if (!drained)
+            {
+               waitHandles.push_back(drainedEvent);
+            }
+
+            if (waitHandles.empty())
+            {
+               break;
+            }
+
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            std::optional<std::chrono::steady_clock::time_point> nextDeadline;
+            for (std::size_t i = 0; i < numProcesses; ++i)
+            {
+               if (jobs[i] && !terminated[i])
+               {
+                  if (now >= deadlines[i])
+                  {
+                     // If it has exited already, this only catches whatever it left running (e.g. holding its pipes open)
+                     results[i].timedOut = !exited[i];
+                     TerminateJobObject(jobs[i], kTerminatedExitCode);
+                     terminated[i] = true;
+                  }
+                  else
+                  {
+                     nextDeadline = std::min(nextDeadline.value_or(deadlines[i]), deadlines[i]);
+                  }
+               }
+            }
+
+            DWORD timeout = nextDeadline ? getTimeoutMilliseconds(*nextDeadline - now) : INFINITE;
+            DWORD result = WaitForMultipleObjects(static_cast<DWORD>(waitHandles.size()), waitHandles.data(), false, timeout);
+            if (result >= WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + waitHandles.size())
+            {
+               std::size_t waitIndex = result - WAIT_OBJECT_0;
+               if (waitIndex < waitIndices.size())
+               {
+                  exited[waitIndices[waitIndex]] = true;
+               }
+               else
+               {
+                  drained = true;
+               }
+            }
+            else if (result != WAIT_TIMEOUT)
+            {
+               break;
+            }
+         }
+
+         for (std::thread& thread : threads)
+         {
+            thread.join();
+         }
+
+         for (std::size_t i = 0; i < numProcesses; ++i)
+         {
+            if (jobs[i])
+            {
+               CloseHandle(jobs[i]);
+            }
+
+            if (!processes[i])
+            {
+               continue;
+            }
+
+            WaitForSingleObject(processes[i]->hProcess, INFINITE);
+
+            DWORD exitCode = 0;
+            if (GetExitCodeProcess(processes[i]->hProcess, &exitCode))
+            {
+               ProcessExitInfo& exitInfo = exitInfos[i].emplace(std::move(results[i]));
+               exitInfo.exitCode = std::bit_cast<int>(exitCode);
+               setResourceUsage(exitInfo, processes[i]->hProcess);
+            }
+
+            CloseHandle(processes[i]->hProcess);
+            CloseHandle(processes[i]->hThread);
+         }
+
+         if (drainedEvent)
+         {
+            CloseHandle(drainedEvent);
+         }
+
+         return exitInfos;
+      }
+   }
+
+   std::string getExecutableSearchPath()
+   {
+      DWORD size = GetEnvironmentVariableW(L"PATH", nullptr, 0);
+      if (size == 0)
+      {
+         return "";
+      }
+
+      std::wstring searchPath(size, L'\0');
+      size = GetEnvironmentVariableW(L"PATH", searchPath.data(), size);
+      searchPath.resize(size);
+
+      return wstringToString(searchPath);
+   }
+
+   std::vector<std::filesystem::path> splitExecutableSearchPath(const std::string& searchPath)
+   {
+      std::vector<std::filesystem::path> directories;
+
+      std::string_view remaining = searchPath;
+      while (true)
+      {
+         std::size_t separatorIndex = remaining.find(';');
+         std::string_view directory = remaining.substr(0, separatorIndex);
+
+         // Entries containing separators can be quoted
+         if (directory.size() >= 2 && directory.front() == '"' && directory.back() == '"')
+         {
+            directory = directory.substr(1, directory.size() - 2);
+         }
+         directories.emplace_back(stringToWstring(std::string(directory)));
+
+         if (separatorIndex == std::string_view::npos)
+         {
+            break;
+         }
+
+         remaining.remove_prefix(separatorIndex + 1);
+      }
+
+      return directories;
+   }
+
+   std::string getExecutableLookupName(const std::filesystem::path& name)
+   {
+      std::wstring lookupName = name.wstring();
+      CharLowerBuffW(lookupName.data(), static_cast<DWORD>(lookupName.size()));
+
+      return wstringToString(lookupName);
+   }
+
+   std::vector<std::string> getExecutableNames(const std::filesystem::path& fileName)
+   {
+      // Only what CreateProcess can run itself, rather than everything in PATHEXT (which includes scripts that need an interpreter)
+      static const std::array<std::string_view, 4> kExtensions = { ".exe", ".com", ".bat", ".cmd" };
+
+      std::string extension = getExecutableLookupName(fileName.extension());
+      if (std::find(kExtensions.begin(), kExtensions.end(), extension) == kExtensions.end())
+      {
+         return {};
+      }
+
+      return { getExecutableLookupName(fileName), getExecutableLookupName(fileName.stem()) };
+   }
+
+   bool isExecutableFile(const std::filesystem::path& path)
+   {
+      DWORD attributes = GetFileAttributesW(path.c_str());
+      return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) == 0;
+   }
+
+   std::optional<ProcessExitInfo> executeProcess(ProcessStartInfo startInfo)
+   {
+      if (startInfo.waitForExit)
+      {
+         std::vector<ProcessStartInfo> startInfos;
+         startInfos.push_back(std::move(startInfo));
+
+         return std::move(runPipeline(startInfos).front());
+      }
+
+      // Without waiting, there's nothing to exchange data with it, all it can read from is a file
+      startProcess(std::move(startInfo));
+      return std::nullopt;
+   }
+
+   std::vector<std::optional<ProcessExitInfo>> executePipeline(std::vector<ProcessStartInfo> startInfos)
+   {
+      return runPipeline(startInfos);
+   }
+
+   std::optional<ProcessHandle> startProcess(ProcessStartInfo startInfo)
+   {
+      HANDLE stdIn = nullptr;
+      if (!startInfo.stdInPath.empty())
+      {
+         stdIn = openInputFile(startInfo.stdInPath);
+         if (!stdIn)
+         {
+            return std::nullopt;
+         }
+      }
+
+      std::optional<PROCESS_INFORMATION> processInformation = launch(startInfo, stdIn, nullptr, nullptr);
+      if (stdIn)
+      {
+         CloseHandle(stdIn);
+      }
+
+      if (!processInformation)
+      {
+         return std::nullopt;
+      }
+
+      CloseHandle(processInformation->hThread);
+
+      return ProcessHandle(processInformation->dwProcessId, reinterpret_cast<ProcessHandle::NativeHandle>(processInformation->hProcess));
+   }
+
+   bool ProcessHandle::tryWait()
+   {
+      if (isValid() && !exited && WaitForSingleObject(reinterpret_cast<HANDLE>(handle), 0) == WAIT_OBJECT_0)
+      {
+         DWORD processExitCode = 0;
+         if (GetExitCodeProcess(reinterpret_cast<HANDLE>(handle), &processExitCode))
+         {
+            exitInfo.emplace().exitCode = std::bit_cast<int>(processExitCode);
+            setResourceUsage(*exitInfo, reinterpret_cast<HANDLE>(handle));
+         }
+
+         exited = true;
+      }
+
+      return exited;
+   }
+
+   bool ProcessHandle::wait(std::optional<std::chrono::milliseconds> timeout)
+   {
+      if (isValid() && !exited)
+      {
+         WaitForSingleObject(reinterpret_cast<HANDLE>(handle), timeout ? getTimeoutMilliseconds(*timeout) : INFINITE);
+      }
+
+      return tryWait();
+   }
+
+   bool ProcessHandle::kill()
+   {
+      return isValid() && !exited && TerminateProcess(reinterpret_cast<HANDLE>(handle), 1);
+   }
+
+   void ProcessHandle::release()
+   {
+      if (isValid())
+      {
+         CloseHandle(reinterpret_cast<HANDLE>(handle));
+
+         id = kInvalidIdentifier;
+         handle = kInvalidHandle;
+         exitInfo.reset();
+         exited = false;
+      }
+   }
+
+   class ProcessReactor::Impl
+   {
+   public:
+      void add(ProcessHandle process, ExitFunction exitFunction)
+      {
+         processes.emplace(nextKey++, Entry{ std::move(process), std::move(exitFunction) });
+      }
+
+      std::size_t wait(std::optional<std::chrono::milliseconds> timeout)
+      {
+         static const std::chrono::milliseconds kMultipleChunkPollInterval(10);
+
+         if (processes.empty())
+         {
+            return 0;
+         }
+
+         std::optional<std::chrono::steady_clock::time_point> deadline;
+         if (timeout)
+         {
+            deadline = std::chrono::steady_clock::now() + *timeout;
+         }
+
+         std::vector<uint64_t> keys;
+         std::vector<HANDLE> handles;
+         keys.reserve(processes.size());
+         handles.reserve(processes.size());
+         for (const auto& [key, entry] : processes)
+         {
+            keys.push_back(key);
+            handles.push_back(reinterpret_cast<HANDLE>(entry.process.getNativeHandle()));
+         }
+
+         // WaitForMultipleObjects takes at most 64 handles, so only a single chunk can be waited on, more than that are checked periodically
+         bool singleChunk = handles.size() <= MAXIMUM_WAIT_OBJECTS;
+
+         std::vector<uint64_t> exitedKeys;
+         while (true)
+         {
+            for (std::size_t start = 0; start < handles.size(); start += MAXIMUM_WAIT_OBJECTS)
+            {
+               DWORD count = static_cast<DWORD>(std::min<std::size_t>(handles.size() - start, MAXIMUM_WAIT_OBJECTS));
+
+               DWORD waitTime = 0;
+               if (singleChunk)
+               {
+                  waitTime = deadline ? getTimeoutMilliseconds(*deadline - std::chrono::steady_clock::now()) : INFINITE;
+               }
+
+               DWORD result = WaitForMultipleObjects(count, handles.data() + start, false, waitTime);
+               if (result >= WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + count)
+               {
+                  // Only the first signaled handle is reported, the rest of the chunk might have exited too
+                  for (std::size_t i = start + (result - WAIT_OBJECT_0); i < start + count; ++i)
+                  {
+                     if (processes.at(keys[i]).process.tryWait())
+                     {
+                        exitedKeys.push_back(keys[i]);
+                     }
+                  }
+               }
+            }
+
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (!exitedKeys.empty() || (deadline && now >= *deadline))
+            {
+               break;
+            }
+
+            if (!singleChunk)
+            {
+               std::this_thread::sleep_for(deadline ? std::min<std::chrono::steady_clock::duration>(*deadline - now, kMultipleChunkPollInterval) : kMultipleChunkPollInterval);
+            }
+         }
+
+         return notify(exitedKeys);
       }
 
-      std::wstring stringToWstring(const std::string& string)
+      std::size_t getNumProcesses() const
       {
-         int numBytes = string.size() <= static_cast<size_t>(std::numeric_limits<int>::max()) ? static_cast<int>(string.size()) : -1;
-         int numWideChars = MultiByteToWideChar(CP_UTF8, 0, string.c_str(), numBytes, nullptr, 0);
-
-         std::wstring wstring(numWideChars, L'\0');
-         MultiByteToWideChar(CP_UTF8, 0, string.c_str(), numBytes, wstring.data(), numWideChars);
-
-         return wstring;
+         return processes.size();
       }
 
-      std::string readTextFromPipe(HANDLE handle)
+   private:
+      struct Entry
+      {
+         ProcessHandle process;
+         ExitFunction exitFunction;
+      };
+
+      std::size_t notify(const std::vector<uint64_t>& exitedKeys)
       {
-         LARGE_INTEGER fileSize{};
-         if (GetFileSizeEx(handle, &fileSize) && fileSize.LowPart > 0 && fileSize.HighPart == 0)
+         // Everything is removed before calling any of the functions, so they're free to add processes
+         std::vector<Entry> exitedEntries;
+         exitedEntries.reserve(exitedKeys.size());
+         for (uint64_t key : exitedKeys)
+         {
+            exitedEntries.push_back(std::move(processes.extract(key).mapped()));
+         }
+
+         for (Entry& entry : exitedEntries)
          {
-            std::string text(fileSize.LowPart, '\0');
-            if (ReadFile(handle, text.data(), fileSize.LowPart, nullptr, nullptr))
+            if (entry.exitFunction)
             {
-               return text;
+               entry.exitFunction(entry.process);
             }
          }
 
-         return std::string{};
+         return exitedEntries.size();
       }
+
+      std::unordered_map<uint64_t, Entry> processes;
+      uint64_t nextKey = 0;
+   };
+
+   ProcessReactor::ProcessReactor()
+      : impl(std::make_unique<Impl>())
+   {
    }
 
-   std::optional<std::filesystem::path> getExecutablePath()
+   ProcessReactor::~ProcessReactor()
    {
-      WCHAR buffer[MAX_PATH + 1];
-      DWORD length = GetModuleFileNameW(nullptr, buffer, MAX_PATH);
-      buffer[length] = '\0';
+   }
 
-      if (length == 0 || length == MAX_PATH || GetLastError() == ERROR_INSUFFICIENT_BUFFER)
+   void ProcessReactor::add(ProcessHandle process, ExitFunction exitFunction)
+   {
+      impl->add(std::move(process), std::move(exitFunction));
+   }
+
+   std::size_t ProcessReactor::wait(std::optional<std::chrono::milliseconds> timeout)
+   {
+      return impl->wait(timeout);
+   }
+
+   std::size_t ProcessReactor::getNumProcesses() const
+   {
+      return impl->getNumProcesses();
+   }
+
+   // Creating a process doesn't copy anything from its parent here, so there's no server, processes are launched directly
+   class ForkServer::Impl
+   {
+   };
+
+   ForkServer::ForkServer()
+   {
+   }
+
+   ForkServer::~ForkServer()
+   {
+   }
+
+   bool ForkServer::isRunning() const
+   {
+      return false;
+   }
+
+   std::optional<ProcessExitInfo> ForkServer::executeProcess(ProcessStartInfo startInfo)
+   {
+      return OSUtils::executeProcess(std::move(startInfo));
+   }
+
+   std::optional<FileInfo> getFileInfo(const std::filesystem::path& path)
+   {
+      HANDLE fileHandle = CreateFileW(path.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+      if (fileHandle == INVALID_HANDLE_VALUE)
       {
-         static const DWORD kUnreasonablyLargeStringLength = 32767;
-         std::vector<WCHAR> unreasonablyLargeBuffer(kUnreasonablyLargeStringLength + 1);
-         length = GetModuleFileNameW(nullptr, unreasonablyLargeBuffer.data(), kUnreasonablyLargeStringLength);
-         unreasonablyLargeBuffer[length] = '\0';
+         return std::nullopt;
+      }
 
-         if (length != 0 && length != kUnreasonablyLargeStringLength && GetLastError() != ERROR_INSUFFICIENT_BUFFER)
-         {
-            return std::filesystem::path(unreasonablyLargeBuffer.data());
-         }
+      BY_HANDLE_FILE_INFORMATION information{};
+      bool succeeded = GetFileInformationByHandle(fileHandle, &information);
+      CloseHandle(fileHandle);
+
+      if (!succeeded)
+      {
+         return std::nullopt;
       }
-      else
+
+      // FILETIMEs count 100ns intervals since 1601
+      static const int64_t kUnixEpochInFileTime = 116444736000000000;
+      int64_t fileTime = static_cast<int64_t>((static_cast<uint64_t>(information.ftLastWriteTime.dwHighDateTime) << 32) | information.ftLastWriteTime.dwLowDateTime);
+
+      FileInfo info;
+      info.device = information.dwVolumeSerialNumber;
+      info.inode = (static_cast<uint64_t>(information.nFileIndexHigh) << 32) | information.nFileIndexLow;
+      info.size = (static_cast<uint64_t>(information.nFileSizeHigh) << 32) | information.nFileSizeLow;
+      info.modificationTime = (fileTime - kUnixEpochInFileTime) * 100;
+
+      return info;
+   }
+
+   std::optional<MappedFile> mapFile(const std::filesystem::path& path, const MapFileOptions& options)
+   {
+      DWORD flags = FILE_ATTRIBUTE_NORMAL;
+      if (options.accessPattern == FileAccessPattern::Sequential)
       {
-         return std::filesystem::path(buffer);
+         flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+      }
+      else if (options.accessPattern == FileAccessPattern::Random)
+      {
+         flags |= FILE_FLAG_RANDOM_ACCESS;
       }
 
-      return std::nullopt;
+      HANDLE fileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+      if (fileHandle == INVALID_HANDLE_VALUE)
+      {
+         return std::nullopt;
+      }
+
+      LARGE_INTEGER fileSize{};
+      if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart <= 0 || static_cast<uint64_t>(fileSize.QuadPart) > std::numeric_limits<std::size_t>::max())
+      {
+         CloseHandle(fileHandle);
+         return std::nullopt;
+      }
+
+      HANDLE mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      CloseHandle(fileHandle);
+      if (!mappingHandle)
+      {
+         return std::nullopt;
+      }
+
+      // The view keeps its own references to the mapping and the file
+      void* data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mappingHandle);
+      if (!data)
+      {
+         return std::nullopt;
+      }
+
+      std::size_t size = static_cast<std::size_t>(fileSize.QuadPart);
+      if (options.prefetch)
+      {
+         WIN32_MEMORY_RANGE_ENTRY range{};
+         range.VirtualAddress = data;
+         range.NumberOfBytes = size;
+         PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+      }
+
+      return MappedFile(static_cast<const uint8_t*>(data), size);
    }
 
-   std::optional<std::filesystem::path> getKnownDirectoryPath(KnownDirectory knownDirectory)
+   void MappedFile::unmap()
    {
-      const KNOWNFOLDERID* folderID = nullptr;
-      switch (knownDirectory)
+      if (data)
       {
-      case KnownDirectory::Home:
-         folderID = &FOLDERID_Profile;
-         break;
-      case KnownDirectory::Desktop:
-         folderID = &FOLDERID_Desktop;
-         break;
-      case KnownDirectory::Downloads:
-         folderID = &FOLDERID_Downloads;
-         break;
-      case KnownDirectory::UserApplications:
-         folderID = &FOLDERID_UserProgramFiles;
-         break;
-      case KnownDirectory::CommonApplications:
-         folderID = &FOLDERID_ProgramFiles;
+         UnmapViewOfFile(data);
+
+         data = nullptr;
+         size = 0;
+      }
+   }
+
+   std::optional<File> openFile(const std::filesystem::path& path, FileOpenMode mode, FileAccessPattern accessPattern)
+   {
+      DWORD access = 0;
+      DWORD creationDisposition = 0;
+      switch (mode)
+      {
+      case FileOpenMode::Read:
+         access = GENERIC_READ;
+         creationDisposition = OPEN_EXISTING;
          break;
-      case KnownDirectory::UserApplicationData:
-         folderID = &FOLDERID_LocalAppData;
+      case FileOpenMode::Write:
+         access = GENERIC_WRITE;
+         creationDisposition = CREATE_ALWAYS;
          break;
-      case KnownDirectory::CommonApplicationData:
-         folderID = &FOLDERID_ProgramData;
+      case FileOpenMode::Append:
+         access = FILE_APPEND_DATA;
+         creationDisposition = OPEN_ALWAYS;
          break;
       default:
-         break;
+         return std::nullopt;
       }
 
-      if (folderID == nullptr)
+      DWORD flags = FILE_ATTRIBUTE_NORMAL;
+      if (accessPattern == FileAccessPattern::Sequential)
+      {
+         flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+      }
+      else if (accessPattern == FileAccessPattern::Random)
+      {
+         flags |= FILE_FLAG_RANDOM_ACCESS;
+      }
+
+      HANDLE fileHandle = CreateFileW(path.c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, creationDisposition, flags, nullptr);
+      if (fileHandle == INVALID_HANDLE_VALUE)
       {
          return std::nullopt;
       }
 
-      std::optional<std::filesystem::path> knownDirectoryPath;
-      PWSTR path = nullptr;
-      if (SHGetKnownFolderPath(*folderID, KF_FLAG_DEFAULT, nullptr, &path) == S_OK)
+      return File(reinterpret_cast<File::NativeHandle>(fileHandle));
+   }
+
+   std::optional<uint64_t> File::getSize() const
+   {
+      HANDLE fileHandle = reinterpret_cast<HANDLE>(handle);
+
+      LARGE_INTEGER fileSize{};
+      if (isOpen() && GetFileType(fileHandle) == FILE_TYPE_DISK && GetFileSizeEx(fileHandle, &fileSize))
       {
-         knownDirectoryPath = std::filesystem::path(path);
+         return static_cast<uint64_t>(fileSize.QuadPart);
       }
-      CoTaskMemFree(path);
 
-      return knownDirectoryPath;
+      return std::nullopt;
    }
 
-   std::unordered_map<std::string, std::string> getEnvironment()
+   std::optional<std::size_t> File::read(std::span<uint8_t> buffer)
    {
-      std::unordered_map<std::string, std::string> environment;
+      HANDLE fileHandle = reinterpret_cast<HANDLE>(handle);
 
-      if (LPWCH environmentStrings = GetEnvironmentStringsW())
+      std::size_t numBytesRead = 0;
+      while (numBytesRead < buffer.size())
       {
-         LPWCH itr = environmentStrings;
-         while (*itr)
+         DWORD numBytesToRead = static_cast<DWORD>(std::min<std::size_t>(buffer.size() - numBytesRead, std::numeric_limits<DWORD>::max()));
+         DWORD result = 0;
+         if (!ReadFile(fileHandle, buffer.data() + numBytesRead, numBytesToRead, &result, nullptr))
          {
-            std::wstring envEntry = itr;
-            std::size_t equalsIndex = envEntry.find('=');
-            if (equalsIndex != 0 && equalsIndex != std::wstring::npos)
+            if (GetLastError() == ERROR_BROKEN_PIPE)
             {
-               std::wstring key = envEntry.substr(0, equalsIndex);
-               std::wstring value = envEntry.substr(equalsIndex + 1);
-               environment.emplace(wstringToString(key), wstringToString(value));
+               break;
             }
 
-            itr += envEntry.size() + 1;
+            return std::nullopt;
          }
 
-         FreeEnvironmentStringsW(environmentStrings);
+         if (result == 0)
+         {
+            break;
+         }
+
+         numBytesRead += result;
       }
 
-      return environment;
+      return numBytesRead;
    }
 
-   std::optional<ProcessExitInfo> executeProcess(ProcessStartInfo startInfo)
+   bool File::write(std::span<const uint8_t> data)
    {
-      std::wstring pathString = startInfo.path.wstring();
+      HANDLE fileHandle = reinterpret_cast<HANDLE>(handle);
 
-      std::wstringstream commandLineStream;
-      commandLineStream << L'\"' << pathString << L'\"';
-      for (const std::string& arg : startInfo.args)
+      std::size_t numBytesWritten = 0;
+      while (numBytesWritten < data.size())
       {
-         commandLineStream << L" \"" << stringToWstring(arg) << L'\"';
+         DWORD numBytesToWrite = static_cast<DWORD>(std::min<std::size_t>(data.size() - numBytesWritten, std::numeric_limits<DWORD>::max()));
+         DWORD result = 0;
+         if (!WriteFile(fileHandle, data.data() + numBytesWritten, numBytesToWrite, &result, nullptr))
+         {
+            return false;
+         }
+
+         numBytesWritten += result;
       }
-      std::wstring commandLine = commandLineStream.str();
 
-      std::wstringstream environmentStream;
-      if (startInfo.inheritEnvironment)
-      {
-         std::unordered_map<std::string, std::string> currentEnvironment = getEnvironment();
+      return true;
+   }
 
-         for (const auto& [key, value] : currentEnvironment)
+   bool File::write(std::span<const std::span<const uint8_t>> fragments)
+   {
+      // WriteFileGather() requires unbuffered, page aligned I/O, so just write each fragment in turn
+      for (std::span<const uint8_t> fragment : fragments)
+      {
+         if (!write(fragment))
          {
-            if (startInfo.env.count(key) == 0) // Provided environment variables take precedence
-            {
-               environmentStream << stringToWstring(key) << L"=" << stringToWstring(value) << L'\0';
-            }
+            return false;
          }
       }
-      for (const auto& [key, value] : startInfo.env)
-      {
-         environmentStream << stringToWstring(key) << L"=" << stringToWstring(value) << L'\0';
-      }
-      std::wstring environment = environmentStream.str();
 
-      bool usePipes = startInfo.waitForExit && startInfo.readOutput;
+      return true;
+   }
+
+   bool File::writeAt(uint64_t offset, std::span<const uint8_t> data)
+   {
+      HANDLE fileHandle = reinterpret_cast<HANDLE>(handle);
+
+      // Remember the current position, as an explicit offset on a synchronous handle moves it
+      LARGE_INTEGER zero{};
+      LARGE_INTEGER position{};
+      SetFilePointerEx(fileHandle, zero, &position, FILE_CURRENT);
 
-      HANDLE hStdOutRead = nullptr;
-      HANDLE hStdOutWrite = nullptr;
-      HANDLE hStdErrRead = nullptr;
-      HANDLE hStdErrWrite = nullptr;
-      if (usePipes)
+      std::size_t numBytesWritten = 0;
+      while (numBytesWritten < data.size())
       {
-         SECURITY_ATTRIBUTES securityAttributes{};
-         securityAttributes.nLength = sizeof(securityAttributes);
-         securityAttributes.bInheritHandle = true;
+         uint64_t writeOffset = offset + numBytesWritten;
 
-         if (!CreatePipe(&hStdOutRead, &hStdOutWrite, &securityAttributes, 0))
-         {
-            return std::nullopt;
-         }
+         OVERLAPPED overlapped{};
+         overlapped.Offset = static_cast<DWORD>(writeOffset & 0xFFFFFFFF);
+         overlapped.OffsetHigh = static_cast<DWORD>(writeOffset >> 32);
 
-         if (!CreatePipe(&hStdErrRead, &hStdErrWrite, &securityAttributes, 0))
+         DWORD numBytesToWrite = static_cast<DWORD>(std::min<std::size_t>(data.size() - numBytesWritten, std::numeric_limits<DWORD>::max()));
+         DWORD result = 0;
+         if (!WriteFile(fileHandle, data.data() + numBytesWritten, numBytesToWrite, &result, &overlapped))
          {
-            CloseHandle(hStdOutRead);
-            CloseHandle(hStdOutWrite);
-            return std::nullopt;
+            SetFilePointerEx(fileHandle, position, nullptr, FILE_BEGIN);
+            return false;
          }
+
+         numBytesWritten += result;
+      }
+
+      SetFilePointerEx(fileHandle, position, nullptr, FILE_BEGIN);
+      return true;
+   }
+
+   bool File::sync()
+   {
+      return FlushFileBuffers(reinterpret_cast<HANDLE>(handle));
+   }
+
+   bool File::setPermissions(std::filesystem::perms /* permissions */)
+   {
+      return isOpen();
+   }
+
+   void File::close()
+   {
+      if (isOpen())
+      {
+         CloseHandle(reinterpret_cast<HANDLE>(handle));
+         handle = kInvalidHandle;
       }
 
-      STARTUPINFOW startupInfo{};
-      startupInfo.cb = sizeof(startupInfo);
-      if (usePipes)
+      if (!temporaryPath.empty())
       {
-         startupInfo.dwFlags |= STARTF_USESTDHANDLES;
-         startupInfo.hStdOutput = hStdOutWrite;
-         startupInfo.hStdError = hStdErrWrite;
+         DeleteFileW(temporaryPath.c_str());
+         temporaryPath.clear();
       }
+   }
 
-      PROCESS_INFORMATION processInformation{};
-      bool processCreated = CreateProcessW(pathString.c_str(), commandLine.data(), nullptr, nullptr, true, CREATE_UNICODE_ENVIRONMENT | DETACHED_PROCESS, environment.data(), nullptr, &startupInfo, &processInformation);
+   std::optional<File> createTemporaryFile(const std::filesystem::path& directory)
+   {
+      std::filesystem::path directoryPath = directory.empty() ? std::filesystem::path(".") : directory;
 
-      if (usePipes)
+      WCHAR temporaryPath[MAX_PATH + 1]{};
+      if (GetTempFileNameW(directoryPath.c_str(), L"tmp", 0, temporaryPath) == 0)
       {
-         CloseHandle(hStdOutWrite);
-         CloseHandle(hStdErrWrite);
+         return std::nullopt;
       }
 
-      std::optional<ProcessExitInfo> exitInfo;
-      if (processCreated)
+      // DELETE access is needed to rename the file through its handle when committing
+      HANDLE fileHandle = CreateFileW(temporaryPath, GENERIC_WRITE | DELETE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, TRUNCATE_EXISTING, FILE_ATTRIBUTE_TEMPORARY, nullptr);
+      if (fileHandle == INVALID_HANDLE_VALUE)
       {
-         if (startInfo.waitForExit)
-         {
-            WaitForSingleObject(processInformation.hProcess, INFINITE);
+         DeleteFileW(temporaryPath);
+         return std::nullopt;
+      }
 
-            DWORD exitCode = 0;
-            if (GetExitCodeProcess(processInformation.hProcess, &exitCode))
-            {
-               exitInfo = ProcessExitInfo{};
-               exitInfo->exitCode = std::bit_cast<int>(exitCode);
-            }
-         }
+      return File(reinterpret_cast<File::NativeHandle>(fileHandle), std::filesystem::path(temporaryPath));
+   }
+
+   bool commitTemporaryFile(File& file, const std::filesystem::path& path)
+   {
+      if (!file.isOpen() || file.temporaryPath.empty())
+      {
+         return false;
+      }
+
+      std::wstring pathString = std::filesystem::absolute(path).wstring();
 
-         CloseHandle(processInformation.hProcess);
-         CloseHandle(processInformation.hThread);
+      std::vector<uint8_t> renameInfoBuffer(sizeof(FILE_RENAME_INFO) + pathString.size() * sizeof(WCHAR));
+      FILE_RENAME_INFO* renameInfo = reinterpret_cast<FILE_RENAME_INFO*>(renameInfoBuffer.data());
+      renameInfo->ReplaceIfExists = true;
+      renameInfo->RootDirectory = nullptr;
+      renameInfo->FileNameLength = static_cast<DWORD>(pathString.size() * sizeof(WCHAR));
+      std::copy(pathString.begin(), pathString.end(), renameInfo->FileName);
+
+      HANDLE fileHandle = reinterpret_cast<HANDLE>(file.handle);
+      if (!SetFileInformationByHandle(fileHandle, FileRenameInfo, renameInfo, static_cast<DWORD>(renameInfoBuffer.size())))
+      {
+         return false;
       }
 
-      if (usePipes)
+      FILE_BASIC_INFO basicInfo{};
+      if (GetFileInformationByHandleEx(fileHandle, FileBasicInfo, &basicInfo, sizeof(basicInfo)))
       {
-         if (exitInfo)
+         basicInfo.FileAttributes &= ~FILE_ATTRIBUTE_TEMPORARY;
+         if (basicInfo.FileAttributes == 0)
          {
-            exitInfo->stdOut = readTextFromPipe(hStdOutRead);
-            exitInfo->stdErr = readTextFromPipe(hStdErrRead);
+            basicInfo.FileAttributes = FILE_ATTRIBUTE_NORMAL;
          }
+         SetFileInformationByHandle(fileHandle, FileBasicInfo, &basicInfo, sizeof(basicInfo));
+      }
+
+      file.temporaryPath.clear();
+      return true;
+   }
+
+   bool syncDirectory(const std::filesystem::path& directory)
+   {
+      // Directories can't be flushed on Windows, NTFS journals metadata changes on its own
+      return std::filesystem::is_directory(directory.empty() ? std::filesystem::path(".") : directory);
+   }
 
-         CloseHandle(hStdOutRead);
-         CloseHandle(hStdErrRead);
+   bool listDirectory(const std::filesystem::path& directory, const DirectoryListFunction& function)
+   {
+      WIN32_FIND_DATAW findData{};
+      HANDLE findHandle = FindFirstFileExW((directory / L"*").c_str(), FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+      if (findHandle == INVALID_HANDLE_VALUE)
+      {
+         return false;
       }
 
-      return exitInfo;
+      do
+      {
+         std::wstring_view wideName = findData.cFileName;
+         if (wideName == L"." || wideName == L"..")
+         {
+            continue;
+         }
+
+         DirectoryEntryType type = DirectoryEntryType::File;
+         if (findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+         {
+            type = DirectoryEntryType::Symlink;
+         }
+         else if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+         {
+            type = DirectoryEntryType::Directory;
+         }
+         else if (findData.dwFileAttributes & FILE_ATTRIBUTE_DEVICE)
+         {
+            type = DirectoryEntryType::Other;
+         }
+
+         function(wideName, type);
+      } while (FindNextFileW(findHandle, &findData));
+
+      FindClose(findHandle);
+      return true;
+   }
+
+   bool cloneFileContents(const File& /* source */, const File& /* destination */)
+   {
+      return false;
+   }
+
+   bool copyFileContents(const File& /* source */, const File& /* destination */, uint64_t /* size */)
+   {
+      return false;
+   }
+
+   bool readFilesAsync(std::span<const std::filesystem::path> /* paths */, std::size_t /* queueDepth */, const AsyncReadFunction& /* function */)
+   {
+      return false;
    }
 
    class DirectoryWatcher::Impl
    {
    public:
+      bool hasPendingEvents() const
+      {
+         return std::any_of(watches.begin(), watches.end(), [](const auto& pair) { return pair.second->hasCompleted(); });
+      }
+
       void update()
       {
          std::vector<Notification> notifications;
@@ -366,6 +1513,12 @@ namespace OSUtils
             return ReadDirectoryChangesW(directoryHandle, buffer.data(), static_cast<DWORD>(buffer.size()), recursive, kFilter, nullptr, &overlapped, nullptr);
          }
 
+         // Unlike waiting on the (auto-reset) event, this doesn't consume the completion
+         bool hasCompleted() const
+         {
+            return HasOverlappedIoCompleted(&overlapped);
+         }
+
          bool poll(std::vector<Notification>& notifications)
          {
             DWORD waitResult = WaitForSingleObject(overlapped.hEvent, 0);
@@ -464,6 +1617,11 @@ namespace OSUtils
       impl->update();
    }
 
+   bool DirectoryWatcher::hasPendingEvents() const
+   {
+      return impl->hasPendingEvents();
+   }
+
    DirectoryWatcher::ID DirectoryWatcher::addWatch(const std::filesystem::path& directory, bool recursive, DirectoryWatcher::NotifyFunction notifyFunction)
    {
       return impl->addWatch(directory, recursive, std::move(notifyFunction));
@@ -3,11 +3,17 @@
 #import <CoreServices/CoreServices.h>
 #import <Foundation/Foundation.h>
 
+#include <dirent.h>
 #include <mach-o/dyld.h>
 #include <stdlib.h>
+#include <sys/event.h>
 #include <sys/param.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <thread>
@@ -16,7 +22,7 @@
 
 namespace OSUtils
 {
-   std::optional<std::filesystem::path> getExecutablePath()
+   std::optional<std::filesystem::path> computeExecutablePath()
    {
       uint32_t size = MAXPATHLEN;
       char rawPath[size];
@@ -32,7 +38,7 @@ namespace OSUtils
       return std::nullopt;
    }
 
-   std::optional<std::filesystem::path> getKnownDirectoryPath(KnownDirectory knownDirectory)
+   std::optional<std::filesystem::path> computeKnownDirectoryPath(KnownDirectory knownDirectory)
    {
       if (knownDirectory == KnownDirectory::Home)
       {
@@ -83,6 +89,58 @@ namespace OSUtils
       return std::nullopt;
    }
 
+   bool listDirectory(const std::filesystem::path& directory, const DirectoryListFunction& function)
+   {
+      DIR* dir = opendir(directory.c_str());
+      if (!dir)
+      {
+         return false;
+      }
+
+      while (const dirent* entry = readdir(dir))
+      {
+         std::string_view name = entry->d_name;
+         if (name == "." || name == "..")
+         {
+            continue;
+         }
+
+         switch (entry->d_type)
+         {
+         case DT_REG:
+            function(name, DirectoryEntryType::File);
+            break;
+         case DT_DIR:
+            function(name, DirectoryEntryType::Directory);
+            break;
+         case DT_LNK:
+            function(name, DirectoryEntryType::Symlink);
+            break;
+         default:
+            function(name, DirectoryEntryType::Other);
+            break;
+         }
+      }
+
+      closedir(dir);
+      return true;
+   }
+
+   bool cloneFileContents(const File& /* source */, const File& /* destination */)
+   {
+      return false;
+   }
+
+   bool copyFileContents(const File& /* source */, const File& /* destination */, uint64_t /* size */)
+   {
+      return false;
+   }
+
+   bool readFilesAsync(std::span<const std::filesystem::path> /* paths */, std::size_t /* queueDepth */, const AsyncReadFunction& /* function */)
+   {
+      return false;
+   }
+
    class DirectoryWatcher::Impl
    {
    public:
@@ -106,6 +164,12 @@ namespace OSUtils
          }
       }
 
+      bool hasPendingEvents()
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         return !notifications.empty();
+      }
+
       void update()
       {
          std::vector<Notification> localNotifications;
@@ -294,6 +358,11 @@ namespace OSUtils
       impl->update();
    }
 
+   bool DirectoryWatcher::hasPendingEvents() const
+   {
+      return impl->hasPendingEvents();
+   }
+
    DirectoryWatcher::ID DirectoryWatcher::addWatch(const std::filesystem::path& directory, bool recursive, DirectoryWatcher::NotifyFunction notifyFunction)
    {
       return impl->addWatch(directory, recursive, std::move(notifyFunction));
@@ -303,4 +372,224 @@ namespace OSUtils
    {
       impl->removeWatch(id);
    }
+
+   namespace
+   {
+      timespec toTimespec(std::chrono::steady_clock::duration duration)
+      {
+         int64_t nanoseconds = std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), 0);
+
+         timespec time{};
+         time.tv_sec = static_cast<time_t>(nanoseconds / 1000000000);
+         time.tv_nsec = static_cast<long>(nanoseconds % 1000000000);
+
+         return time;
+      }
+
+      // Fails (ESRCH) if the process has already exited
+      bool addExitEvent(int queue, ProcessHandle::ID processId, uint64_t key)
+      {
+         struct kevent change{};
+         EV_SET(&change, static_cast<uintptr_t>(processId), EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, reinterpret_cast<void*>(static_cast<uintptr_t>(key)));
+
+         return kevent(queue, &change, 1, nullptr, 0, nullptr) == 0;
+      }
+   }
+
+   ProcessHandle::NativeHandle openProcessHandle(ProcessHandle::ID processId)
+   {
+      // There's no descriptor for a process, kqueue watches process IDs directly
+      return ProcessHandle::kInvalidHandle;
+   }
+
+   void waitForProcessExit(ProcessHandle::ID processId, ProcessHandle::NativeHandle nativeHandle, std::chrono::milliseconds timeout)
+   {
+      int queue = kqueue();
+      if (queue == -1)
+      {
+         return;
+      }
+
+      if (addExitEvent(queue, processId, 0))
+      {
+         struct kevent event{};
+         timespec time = toTimespec(timeout);
+         kevent(queue, nullptr, 0, &event, 1, &time);
+      }
+
+      close(queue);
+   }
+
+   class ProcessReactor::Impl
+   {
+   public:
+      Impl()
+         : queue(kqueue())
+      {
+      }
+
+      ~Impl()
+      {
+         if (queue != -1)
+         {
+            close(queue);
+         }
+      }
+
+      void add(ProcessHandle process, ExitFunction exitFunction)
+      {
+         uint64_t key = nextKey++;
+
+         // If the process exited before it could be watched, the next wait() picks it up
+         if (queue == -1 || !addExitEvent(queue, process.getId(), key))
+         {
+            unwatchedKeys.push_back(key);
+         }
+
+         processes.emplace(key, Entry{ std::move(process), std::move(exitFunction) });
+      }
+
+      std::size_t wait(std::optional<std::chrono::milliseconds> timeout)
+      {
+         static const int kMaxEvents = 64;
+         static const std::chrono::milliseconds kUnwatchedPollInterval(10);
+
+         if (processes.empty())
+         {
+            return 0;
+         }
+
+         std::optional<std::chrono::steady_clock::time_point> deadline;
+         if (timeout)
+         {
+            deadline = std::chrono::steady_clock::now() + *timeout;
+         }
+
+         std::vector<uint64_t> exitedKeys;
+         while (true)
+         {
+            for (uint64_t key : unwatchedKeys)
+            {
+               if (processes.at(key).process.tryWait())
+               {
+                  exitedKeys.push_back(key);
+               }
+            }
+
+            std::optional<std::chrono::steady_clock::duration> waitTime;
+            if (!exitedKeys.empty())
+            {
+               waitTime = std::chrono::steady_clock::duration::zero();
+            }
+            else
+            {
+               if (deadline)
+               {
+                  waitTime = *deadline - std::chrono::steady_clock::now();
+               }
+
+               if (!unwatchedKeys.empty())
+               {
+                  waitTime = waitTime ? std::min<std::chrono::steady_clock::duration>(*waitTime, kUnwatchedPollInterval) : kUnwatchedPollInterval;
+               }
+            }
+
+            if (queue != -1)
+            {
+               std::array<struct kevent, kMaxEvents> events{};
+               timespec time = toTimespec(waitTime.value_or(std::chrono::steady_clock::duration::zero()));
+               int numEvents = kevent(queue, nullptr, 0, events.data(), kMaxEvents, waitTime ? &time : nullptr);
+               for (int i = 0; i < numEvents; ++i)
+               {
+                  auto location = processes.find(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(events[i].udata)));
+                  if (location != processes.end() && location->second.process.tryWait())
+                  {
+                     exitedKeys.push_back(location->first);
+                  }
+               }
+            }
+            else
+            {
+               // Everything is unwatched, so there's always a wait time
+               std::this_thread::sleep_for(*waitTime);
+            }
+
+            if (!exitedKeys.empty() || (deadline && std::chrono::steady_clock::now() >= *deadline))
+            {
+               break;
+            }
+         }
+
+         return notify(exitedKeys);
+      }
+
+      std::size_t getNumProcesses() const
+      {
+         return processes.size();
+      }
+
+   private:
+      struct Entry
+      {
+         ProcessHandle process;
+         ExitFunction exitFunction;
+      };
+
+      std::size_t notify(const std::vector<uint64_t>& exitedKeys)
+      {
+         // Everything is removed before calling any of the functions, so they're free to add processes
+         // (The events were one-shot, so there's nothing to unregister)
+         std::vector<Entry> exitedEntries;
+         exitedEntries.reserve(exitedKeys.size());
+         for (uint64_t key : exitedKeys)
+         {
+            exitedEntries.push_back(std::move(processes.extract(key).mapped()));
+
+            auto location = std::find(unwatchedKeys.begin(), unwatchedKeys.end(), key);
+            if (location != unwatchedKeys.end())
+            {
+               unwatchedKeys.erase(location);
+            }
+         }
+
+         for (Entry& entry : exitedEntries)
+         {
+            if (entry.exitFunction)
+            {
+               entry.exitFunction(entry.process);
+            }
+         }
+
+         return exitedEntries.size();
+      }
+
+      int queue = -1;
+      std::unordered_map<uint64_t, Entry> processes;
+      std::vector<uint64_t> unwatchedKeys; // Processes that had exited before they could be watched
+      uint64_t nextKey = 0;
+   };
+
+   ProcessReactor::ProcessReactor()
+      : impl(std::make_unique<Impl>())
+   {
+   }
+
+   ProcessReactor::~ProcessReactor()
+   {
+   }
+
+   void ProcessReactor::add(ProcessHandle process, ExitFunction exitFunction)
+   {
+      impl->add(std::move(process), std::move(exitFunction));
+   }
+
+   std::size_t ProcessReactor::wait(std::optional<std::chrono::milliseconds> timeout)
+   {
+      return impl->wait(timeout);
+   }
+
+   std::size_t ProcessReactor::getNumProcesses() const
+   {
+      return impl->getNumProcesses();
+   }
 }
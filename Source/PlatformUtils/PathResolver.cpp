@@ -0,0 +1,258 @@
+#include "PlatformUtils/PathResolver.h"
+
+#include "PlatformUtils/IOUtils.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace IOUtils
+{
+   namespace
+   {
+      bool containsParentReference(const std::filesystem::path& path)
+      {
+         return std::any_of(path.begin(), path.end(), [](const std::filesystem::path& element) { return element == ".."; });
+      }
+
+      std::filesystem::path removeTrailingSeparator(const std::filesystem::path& path)
+      {
+         return path.has_filename() ? path : path.parent_path();
+      }
+   }
+
+   PathResolver::~PathResolver()
+   {
+      clear();
+   }
+
+   void PathResolver::update()
+   {
+      std::unique_lock<std::shared_mutex> lock(mutex);
+
+      updating = true;
+      directoryWatcher.update();
+      updating = false;
+
+      for (OSUtils::DirectoryWatcher::ID id : watchesToRemove)
+      {
+         directoryWatcher.removeWatch(id);
+      }
+      watchesToRemove.clear();
+   }
+
+   std::optional<std::filesystem::path> PathResolver::resolve(const std::filesystem::path& base, const std::filesystem::path& relativePath)
+   {
+      if (!base.is_absolute() || !relativePath.is_relative())
+      {
+         return std::nullopt;
+      }
+
+      std::filesystem::path normalizedPath = (base / relativePath).lexically_normal();
+      {
+         std::shared_lock<std::shared_mutex> lock(mutex);
+
+         auto location = resolvedPaths.find(normalizedPath);
+         if (location != resolvedPaths.end())
+         {
+            ++numHits;
+            return location->second;
+         }
+      }
+
+      ++numMisses;
+
+      if (!normalizedPath.has_filename() || containsParentReference(base) || containsParentReference(relativePath))
+      {
+         return getAbsolutePath(base, relativePath);
+      }
+
+      std::filesystem::path directory = normalizedPath.parent_path();
+      std::optional<std::filesystem::path> resolvedDirectory;
+      uint64_t invalidationCount = 0;
+      {
+         std::unique_lock<std::shared_mutex> lock(mutex);
+
+         // Start watching before touching the file system, so that changes made in the meantime aren't missed
+         watchDirectories(removeTrailingSeparator(base.lexically_normal()), directory);
+         invalidationCount = invalidationCounter;
+
+         auto location = cachedDirectories.find(directory);
+         if (location != cachedDirectories.end())
+         {
+            resolvedDirectory = location->second.resolvedPath;
+         }
+      }
+
+      std::error_code errorCode;
+      if (!resolvedDirectory)
+      {
+         resolvedDirectory = std::filesystem::weakly_canonical(directory, errorCode);
+         if (errorCode)
+         {
+            return std::nullopt;
+         }
+      }
+
+      std::filesystem::path resolvedPath;
+      if (std::filesystem::is_symlink(std::filesystem::symlink_status(normalizedPath, errorCode)))
+      {
+         resolvedPath = std::filesystem::weakly_canonical(normalizedPath, errorCode);
+         if (errorCode)
+         {
+            return std::nullopt;
+         }
+      }
+      else
+      {
+         resolvedPath = *resolvedDirectory / normalizedPath.filename();
+      }
+
+      std::unique_lock<std::shared_mutex> lock(mutex);
+
+      // If anything was invalidated while resolving, the result might already be stale, so don't cache it
+      if (invalidationCount == invalidationCounter)
+      {
+         CachedDirectory& cachedDirectory = getCachedDirectory(directory);
+         cachedDirectory.resolvedPath = std::move(*resolvedDirectory);
+         cachedDirectory.fileNames.insert(normalizedPath.filename());
+
+         resolvedPaths.emplace(std::move(normalizedPath), resolvedPath);
+      }
+
+      return resolvedPath;
+   }
+
+   std::optional<std::filesystem::path> PathResolver::resolveProjectPath(const std::filesystem::path& relativePath)
+   {
+      if (std::optional<std::filesystem::path> projectDirectory = findProjectDirectory())
+      {
+         return resolve(*projectDirectory, relativePath);
+      }
+
+      return std::nullopt;
+   }
+
+   void PathResolver::invalidate(const std::filesystem::path& path)
+   {
+      std::unique_lock<std::shared_mutex> lock(mutex);
+
+      invalidateWithinLock(removeTrailingSeparator(path.lexically_normal()));
+   }
+
+   void PathResolver::clear()
+   {
+      std::unique_lock<std::shared_mutex> lock(mutex);
+
+      ++invalidationCounter;
+
+      resolvedPaths.clear();
+
+      for (const auto& [directory, cachedDirectory] : cachedDirectories)
+      {
+         if (cachedDirectory.watchId != OSUtils::DirectoryWatcher::kInvalidIdentifier)
+         {
+            directoryWatcher.removeWatch(cachedDirectory.watchId);
+         }
+      }
+      cachedDirectories.clear();
+   }
+
+   uint64_t PathResolver::getNumHits() const
+   {
+      return numHits;
+   }
+
+   uint64_t PathResolver::getNumMisses() const
+   {
+      return numMisses;
+   }
+
+   PathResolver::CachedDirectory& PathResolver::getCachedDirectory(const std::filesystem::path& directory)
+   {
+      auto [location, inserted] = cachedDirectories.try_emplace(directory);
+      if (inserted && directory.has_relative_path())
+      {
+         getCachedDirectory(directory.parent_path()).subdirectories.insert(directory);
+      }
+
+      return location->second;
+   }
+
+   void PathResolver::watchDirectories(const std::filesystem::path& base, const std::filesystem::path& directory)
+   {
+      // Replacing any directory along the way (e.g. with a symlink) changes the resolution of everything under it, so each level needs a watch
+      for (std::filesystem::path level = directory; ; level = level.parent_path())
+      {
+         CachedDirectory& cachedDirectory = getCachedDirectory(level);
+         if (cachedDirectory.watchId == OSUtils::DirectoryWatcher::kInvalidIdentifier)
+         {
+            // Notifications are delivered from update(), which already holds the lock
+            // Directories that don't exist (yet) can't be watched, but their creation will be seen by a watch further up
+            cachedDirectory.watchId = directoryWatcher.addWatch(level, false, [this](OSUtils::DirectoryWatchEvent event, const std::filesystem::path& watchedDirectory, const std::filesystem::path& file)
+            {
+               // Modifying a file's contents doesn't change what its path resolves to
+               if (event != OSUtils::DirectoryWatchEvent::Modify)
+               {
+                  invalidateWithinLock((watchedDirectory / file).lexically_normal());
+               }
+            });
+         }
+
+         if (level == base || !level.has_relative_path())
+         {
+            break;
+         }
+      }
+   }
+
+   void PathResolver::invalidateWithinLock(const std::filesystem::path& path)
+   {
+      ++invalidationCounter;
+
+      std::filesystem::path parent = path.parent_path();
+      auto parentLocation = path.has_relative_path() ? cachedDirectories.find(parent) : cachedDirectories.end();
+      if (parentLocation != cachedDirectories.end())
+      {
+         parentLocation->second.fileNames.erase(path.filename());
+         parentLocation->second.subdirectories.erase(path);
+      }
+
+      resolvedPaths.erase(path);
+      eraseCachedDirectory(path);
+   }
+
+   void PathResolver::eraseCachedDirectory(const std::filesystem::path& directory)
+   {
+      auto location = cachedDirectories.find(directory);
+      if (location == cachedDirectories.end())
+      {
+         return;
+      }
+
+      CachedDirectory cachedDirectory = std::move(location->second);
+      cachedDirectories.erase(location);
+
+      for (const std::filesystem::path& fileName : cachedDirectory.fileNames)
+      {
+         resolvedPaths.erase(directory / fileName);
+      }
+
+      // Watches don't survive their directory being deleted or moved, so they need to be set up again on the next resolution
+      if (cachedDirectory.watchId != OSUtils::DirectoryWatcher::kInvalidIdentifier)
+      {
+         if (updating)
+         {
+            watchesToRemove.push_back(cachedDirectory.watchId);
+         }
+         else
+         {
+            directoryWatcher.removeWatch(cachedDirectory.watchId);
+         }
+      }
+
+      for (const std::filesystem::path& subdirectory : cachedDirectory.subdirectories)
+      {
+         eraseCachedDirectory(subdirectory);
+      }
+   }
+}
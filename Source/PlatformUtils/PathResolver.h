@@ -0,0 +1,70 @@
+#pragma once
+
+#include "OSUtils.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace IOUtils
+{
+   // Caching equivalent of getAbsolutePath(), remembering both resolved paths and the canonical forms of their directories
+   // Every directory between a base and a resolved path is watched, and cached entries are invalidated by watch notifications (delivered by update())
+   // Changes above the base directory itself aren't detected
+   class PathResolver
+   {
+   public:
+      PathResolver() = default;
+      PathResolver(const PathResolver& other) = delete;
+      ~PathResolver();
+
+      PathResolver& operator=(const PathResolver& other) = delete;
+
+      // Processes pending file system notifications, should be called regularly (e.g. once per frame)
+      void update();
+
+      // Same result as getAbsolutePath(), but only the first resolution of a path touches the file system
+      // New paths in an already resolved directory are resolved lexically (after checking that the file itself isn't a symlink)
+      // Paths containing ".." are always resolved from scratch, since the parent of a symlink isn't the lexical parent
+      std::optional<std::filesystem::path> resolve(const std::filesystem::path& base, const std::filesystem::path& relativePath);
+      std::optional<std::filesystem::path> resolveProjectPath(const std::filesystem::path& relativePath);
+
+      void invalidate(const std::filesystem::path& path); // Also invalidates everything under the path
+      void clear();
+
+      uint64_t getNumHits() const;
+      uint64_t getNumMisses() const;
+
+   private:
+      struct CachedDirectory
+      {
+         std::optional<std::filesystem::path> resolvedPath;
+         OSUtils::DirectoryWatcher::ID watchId = OSUtils::DirectoryWatcher::kInvalidIdentifier;
+         std::unordered_set<std::filesystem::path> fileNames; // Of the resolved paths directly in this directory
+         std::unordered_set<std::filesystem::path> subdirectories;
+      };
+
+      CachedDirectory& getCachedDirectory(const std::filesystem::path& directory);
+      void watchDirectories(const std::filesystem::path& base, const std::filesystem::path& directory);
+      void invalidateWithinLock(const std::filesystem::path& path);
+      void eraseCachedDirectory(const std::filesystem::path& directory);
+
+      mutable std::shared_mutex mutex;
+      OSUtils::DirectoryWatcher directoryWatcher;
+
+      // Directories form a tree (every ancestor of a cached directory is cached too), so invalidating a path only visits what's under it
+      std::unordered_map<std::filesystem::path, std::filesystem::path> resolvedPaths; // Keyed by the lexically normal path
+      std::unordered_map<std::filesystem::path, CachedDirectory> cachedDirectories;
+      std::vector<OSUtils::DirectoryWatcher::ID> watchesToRemove; // Watches can't be removed while their notifications are being delivered
+      bool updating = false;
+      uint64_t invalidationCounter = 0;
+
+      std::atomic<uint64_t> numHits = { 0 };
+      std::atomic<uint64_t> numMisses = { 0 };
+   };
+}
@@ -0,0 +1,186 @@
+#include "PlatformUtils/ProcessPool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace OSUtils
+{
+   ProcessPool::ProcessPool(const ProcessPoolOptions& poolOptions)
+      : options(poolOptions)
+   {
+      if (options.maxConcurrency == 0)
+      {
+         options.maxConcurrency = std::max(std::thread::hardware_concurrency(), 1u);
+      }
+   }
+
+   ProcessPool::~ProcessPool()
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+
+         stopping = true;
+         queuedJobs.clear();
+      }
+
+      jobCondition.notify_all();
+
+      for (std::thread& worker : workers)
+      {
+         worker.join();
+      }
+   }
+
+   uint64_t ProcessPool::submit(ProcessStartInfo startInfo, int priority)
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+
+      uint64_t id = nextJobId++;
+      if (cancelled)
+      {
+         ProcessJobResult result;
+         result.id = id;
+         result.cancelled = true;
+         results.push_back(std::move(result));
+
+         lock.unlock();
+         resultCondition.notify_all();
+
+         return id;
+      }
+
+      startInfo.waitForExit = true;
+      queuedJobs.push_back(Job{ id, priority, std::move(startInfo) });
+      std::push_heap(queuedJobs.begin(), queuedJobs.end(), comparePriority);
+
+      // Idle workers pick up queued jobs themselves, new ones are only needed once they're all busy
+      if (numIdleWorkers < queuedJobs.size() && workers.size() < options.maxConcurrency)
+      {
+         workers.emplace_back([this]() { runWorker(); });
+      }
+
+      lock.unlock();
+      jobCondition.notify_one();
+
+      return id;
+   }
+
+   std::optional<ProcessJobResult> ProcessPool::waitForResult()
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      resultCondition.wait(lock, [this]() { return !results.empty() || (queuedJobs.empty() && numRunningJobs == 0); });
+
+      return takeResult();
+   }
+
+   std::optional<ProcessJobResult> ProcessPool::tryGetResult()
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      return takeResult();
+   }
+
+   void ProcessPool::cancel()
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         cancelQueuedJobs();
+      }
+
+      resultCondition.notify_all();
+   }
+
+   bool ProcessPool::isCancelled() const
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      return cancelled;
+   }
+
+   std::size_t ProcessPool::getNumPendingJobs() const
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      return queuedJobs.size() + numRunningJobs + results.size();
+   }
+
+   bool ProcessPool::comparePriority(const Job& first, const Job& second)
+   {
+      // The heap's top is the "largest" job: highest priority, then lowest ID
+      if (first.priority != second.priority)
+      {
+         return first.priority < second.priority;
+      }
+
+      return first.id > second.id;
+   }
+
+   void ProcessPool::runWorker()
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+
+      while (true)
+      {
+         ++numIdleWorkers;
+         jobCondition.wait(lock, [this]() { return stopping || !queuedJobs.empty(); });
+         --numIdleWorkers;
+
+         if (queuedJobs.empty())
+         {
+            break;
+         }
+
+         std::pop_heap(queuedJobs.begin(), queuedJobs.end(), comparePriority);
+         Job job = std::move(queuedJobs.back());
+         queuedJobs.pop_back();
+         ++numRunningJobs;
+
+         lock.unlock();
+         std::optional<ProcessExitInfo> exitInfo = executeProcess(std::move(job.startInfo));
+         lock.lock();
+
+         --numRunningJobs;
+
+         ProcessJobResult result;
+         result.id = job.id;
+         result.exitInfo = std::move(exitInfo);
+
+         bool failed = !result.succeeded();
+         results.push_back(std::move(result));
+
+         if (failed && options.failFast)
+         {
+            cancelQueuedJobs();
+         }
+
+         resultCondition.notify_all();
+      }
+   }
+
+   void ProcessPool::cancelQueuedJobs()
+   {
+      cancelled = true;
+
+      // Reported in the order they would have run in
+      std::sort(queuedJobs.begin(), queuedJobs.end(), [](const Job& first, const Job& second) { return comparePriority(second, first); });
+      for (const Job& job : queuedJobs)
+      {
+         ProcessJobResult result;
+         result.id = job.id;
+         result.cancelled = true;
+         results.push_back(std::move(result));
+      }
+
+      queuedJobs.clear();
+   }
+
+   std::optional<ProcessJobResult> ProcessPool::takeResult()
+   {
+      if (results.empty())
+      {
+         return std::nullopt;
+      }
+
+      ProcessJobResult result = std::move(results.front());
+      results.pop_front();
+
+      return result;
+   }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "OSUtils.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace OSUtils
+{
+   struct ProcessPoolOptions
+   {
+      // How many processes run at once, 0 for the number of hardware threads
+      std::size_t maxConcurrency = 0;
+
+      // Once a job fails (couldn't be started, or didn't exit with 0), all queued jobs are cancelled
+      // Jobs that are already running are left to finish (like make without -k)
+      bool failFast = false;
+   };
+
+   struct ProcessJobResult
+   {
+      uint64_t id = 0;
+      bool cancelled = false; // Never started, because the pool was cancelled
+      std::optional<ProcessExitInfo> exitInfo; // std::nullopt if it couldn't be started (or was cancelled)
+
+      bool succeeded() const
+      {
+         return exitInfo && exitInfo->exitCode == 0;
+      }
+   };
+
+   // Runs queued processes in parallel, with a limited number in flight at once
+   // Each running job occupies a worker thread (created as needed, up to the concurrency limit) that launches it and drains its output
+   class ProcessPool
+   {
+   public:
+      explicit ProcessPool(const ProcessPoolOptions& poolOptions = {});
+      ProcessPool(const ProcessPool& other) = delete;
+      ~ProcessPool(); // Drops queued jobs and waits for running ones
+
+      ProcessPool& operator=(const ProcessPool& other) = delete;
+
+      // Queues a job (waitForExit is always treated as true), returning its ID
+      // Jobs with higher priorities start first, equal priorities start in the order they were submitted
+      uint64_t submit(ProcessStartInfo startInfo, int priority = 0);
+
+      // Blocks until the next job completes (or is cancelled), returning std::nullopt once every submitted job's result has been taken
+      std::optional<ProcessJobResult> waitForResult();
+
+      // Returns the next result if there already is one, without blocking
+      std::optional<ProcessJobResult> tryGetResult();
+
+      // Cancels every queued job (and any submitted afterwards), running ones are left to finish
+      void cancel();
+
+      bool isCancelled() const;
+
+      // Jobs that are queued, running, or finished with their results not taken yet
+      std::size_t getNumPendingJobs() const;
+
+   private:
+      struct Job
+      {
+         uint64_t id = 0;
+         int priority = 0;
+         ProcessStartInfo startInfo;
+      };
+
+      static bool comparePriority(const Job& first, const Job& second);
+
+      void runWorker();
+      void cancelQueuedJobs();
+      std::optional<ProcessJobResult> takeResult();
+
+      ProcessPoolOptions options;
+      std::vector<std::thread> workers;
+
+      mutable std::mutex mutex;
+      std::condition_variable jobCondition;
+      std::condition_variable resultCondition;
+      std::vector<Job> queuedJobs; // Heap, by priority and then ID
+      std::deque<ProcessJobResult> results;
+      uint64_t nextJobId = 0;
+      std::size_t numIdleWorkers = 0;
+      std::size_t numRunningJobs = 0;
+      bool cancelled = false;
+      bool stopping = false;
+   };
+}
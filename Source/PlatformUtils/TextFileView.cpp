@@ -0,0 +1,53 @@
+#include "PlatformUtils/TextFileView.h"
+
+#include "PlatformUtils/IOUtils.h"
+#include "PlatformUtils/TextUtils.h"
+
+#include <utility>
+
+namespace IOUtils
+{
+   TextFileView::TextFileView(std::optional<OSUtils::MappedFile> mapped, std::string loaded, const TextFileViewOptions& options)
+      : mappedFile(std::move(mapped))
+      , loadedText(std::move(loaded))
+   {
+      lineStarts = TextUtils::findLineStarts(getText(), options.numThreads);
+   }
+
+   std::string_view TextFileView::getText() const
+   {
+      if (mappedFile)
+      {
+         std::span<const uint8_t> data = mappedFile->getData();
+         return std::string_view(reinterpret_cast<const char*>(data.data()), data.size());
+      }
+
+      return loadedText;
+   }
+
+   std::string_view TextFileView::getLine(std::size_t index) const
+   {
+      std::string_view text = getText();
+      return TextUtils::getLine(text, lineStarts[index], index + 1 < lineStarts.size() ? lineStarts[index + 1] : text.size());
+   }
+
+   std::optional<TextFileView> openTextFile(const std::filesystem::path& path, const TextFileViewOptions& options)
+   {
+      // Building the line index touches the whole file anyway
+      OSUtils::MapFileOptions mapOptions;
+      mapOptions.prefetch = true;
+
+      if (std::optional<OSUtils::MappedFile> mappedFile = OSUtils::mapFile(path, mapOptions))
+      {
+         return TextFileView(std::move(mappedFile), std::string{}, options);
+      }
+
+      // Empty files and special files can't be mapped
+      if (std::optional<std::string> text = readTextFile(path))
+      {
+         return TextFileView(std::nullopt, std::move(*text), options);
+      }
+
+      return std::nullopt;
+   }
+}
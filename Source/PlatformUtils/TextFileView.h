@@ -0,0 +1,157 @@
+#pragma once
+
+#include "OSUtils.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace IOUtils
+{
+   struct TextFileViewOptions
+   {
+      std::size_t numThreads = 1; // For building the line index of large files, 0 to use the hardware concurrency
+   };
+
+   // Read-only view of a text file (mapped where possible) with an index of its lines, handing out lines without copying them
+   class TextFileView
+   {
+   public:
+      class LineIterator
+      {
+      public:
+         using iterator_category = std::random_access_iterator_tag;
+         using value_type = std::string_view;
+         using difference_type = std::ptrdiff_t;
+         using pointer = void;
+         using reference = std::string_view;
+
+         LineIterator() = default;
+
+         std::string_view operator*() const
+         {
+            return view->getLine(index);
+         }
+
+         std::string_view operator[](difference_type offset) const
+         {
+            return view->getLine(index + offset);
+         }
+
+         LineIterator& operator++()
+         {
+            ++index;
+            return *this;
+         }
+
+         LineIterator operator++(int)
+         {
+            LineIterator previous = *this;
+            ++index;
+            return previous;
+         }
+
+         LineIterator& operator--()
+         {
+            --index;
+            return *this;
+         }
+
+         LineIterator operator--(int)
+         {
+            LineIterator previous = *this;
+            --index;
+            return previous;
+         }
+
+         LineIterator& operator+=(difference_type offset)
+         {
+            index += offset;
+            return *this;
+         }
+
+         LineIterator& operator-=(difference_type offset)
+         {
+            index -= offset;
+            return *this;
+         }
+
+         friend LineIterator operator+(LineIterator iterator, difference_type offset)
+         {
+            return iterator += offset;
+         }
+
+         friend LineIterator operator+(difference_type offset, LineIterator iterator)
+         {
+            return iterator += offset;
+         }
+
+         friend LineIterator operator-(LineIterator iterator, difference_type offset)
+         {
+            return iterator -= offset;
+         }
+
+         friend difference_type operator-(const LineIterator& first, const LineIterator& second)
+         {
+            return static_cast<difference_type>(first.index) - static_cast<difference_type>(second.index);
+         }
+
+         friend bool operator==(const LineIterator& first, const LineIterator& second)
+         {
+            return first.index == second.index;
+         }
+
+         friend auto operator<=>(const LineIterator& first, const LineIterator& second)
+         {
+            return first.index <=> second.index;
+         }
+
+      private:
+         friend class TextFileView;
+
+         LineIterator(const TextFileView& owningView, std::size_t lineIndex)
+            : view(&owningView)
+            , index(lineIndex)
+         {
+         }
+
+         const TextFileView* view = nullptr;
+         std::size_t index = 0;
+      };
+
+      std::string_view getText() const;
+
+      std::size_t getNumLines() const
+      {
+         return lineStarts.size();
+      }
+
+      // Without the line's "\n" or "\r\n"
+      std::string_view getLine(std::size_t index) const;
+
+      LineIterator begin() const
+      {
+         return LineIterator(*this, 0);
+      }
+
+      LineIterator end() const
+      {
+         return LineIterator(*this, getNumLines());
+      }
+
+   private:
+      friend std::optional<TextFileView> openTextFile(const std::filesystem::path& path, const TextFileViewOptions& options);
+
+      TextFileView(std::optional<OSUtils::MappedFile> mapped, std::string loaded, const TextFileViewOptions& options);
+
+      std::optional<OSUtils::MappedFile> mappedFile;
+      std::string loadedText; // Used instead of a mapping for empty and special files
+      std::vector<std::size_t> lineStarts;
+   };
+
+   std::optional<TextFileView> openTextFile(const std::filesystem::path& path, const TextFileViewOptions& options = {});
+}
@@ -0,0 +1,632 @@
+#include "PlatformUtils/TextUtils.h"
+
+#include "PlatformUtils/OSUtils.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  define PLATFORM_UTILS_TEXT_X64 1
+#  include <immintrin.h>
+#  if defined(_MSC_VER) && !defined(__clang__)
+#     define PLATFORM_UTILS_TARGET_SSSE3
+#     define PLATFORM_UTILS_TARGET_AVX2
+#  else
+#     define PLATFORM_UTILS_TARGET_SSSE3 __attribute__((target("ssse3")))
+#     define PLATFORM_UTILS_TARGET_AVX2 __attribute__((target("avx2")))
+#  endif
+#endif
+
+namespace TextUtils
+{
+   namespace
+   {
+      // Below this, splitting the scan across threads costs more than it saves
+      const std::size_t kMinBytesPerThread = 4 * 1024 * 1024;
+
+      void appendLineStarts(uint64_t newlineMask, std::size_t offset, std::vector<std::size_t>& lineStarts)
+      {
+         while (newlineMask != 0)
+         {
+            lineStarts.push_back(offset + std::countr_zero(newlineMask) + 1);
+            newlineMask &= newlineMask - 1;
+         }
+      }
+
+      void findLineStartsScalar(const char* data, std::size_t size, std::size_t offset, std::vector<std::size_t>& lineStarts)
+      {
+         const char* end = data + size;
+         for (const char* newline = data; (newline = static_cast<const char*>(std::memchr(newline, '\n', end - newline))) != nullptr; ++newline)
+         {
+            lineStarts.push_back(offset + (newline - data) + 1);
+         }
+      }
+
+#if PLATFORM_UTILS_TEXT_X64
+      void findLineStartsSSE2(const char* data, std::size_t size, std::size_t offset, std::vector<std::size_t>& lineStarts)
+      {
+         static const std::size_t kVectorSize = 16;
+
+         __m128i newline = _mm_set1_epi8('\n');
+
+         std::size_t position = 0;
+         for (; position + kVectorSize <= size; position += kVectorSize)
+         {
+            __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(value, newline)));
+            appendLineStarts(mask, offset + position, lineStarts);
+         }
+
+         findLineStartsScalar(data + position, size - position, offset + position, lineStarts);
+      }
+
+      PLATFORM_UTILS_TARGET_AVX2 void findLineStartsAVX2(const char* data, std::size_t size, std::size_t offset, std::vector<std::size_t>& lineStarts)
+      {
+         static const std::size_t kVectorSize = 32;
+
+         __m256i newline = _mm256_set1_epi8('\n');
+
+         // Two vectors per iteration, so that a whole 64-bit mask is processed at once
+         std::size_t position = 0;
+         for (; position + kVectorSize * 2 <= size; position += kVectorSize * 2)
+         {
+            __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + position));
+            __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + position + kVectorSize));
+            uint64_t lowMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, newline)));
+            uint64_t highMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, newline)));
+            appendLineStarts(lowMask | (highMask << 32), offset + position, lineStarts);
+         }
+
+         findLineStartsScalar(data + position, size - position, offset + position, lineStarts);
+      }
+#endif
+
+      using FindLineStartsFunction = void(*)(const char* data, std::size_t size, std::size_t offset, std::vector<std::size_t>& lineStarts);
+
+      FindLineStartsFunction selectFindLineStartsFunction()
+      {
+#if PLATFORM_UTILS_TEXT_X64
+         const OSUtils::CPUFeatures& features = OSUtils::getCPUFeatures();
+         if (features.avx2)
+         {
+            return &findLineStartsAVX2;
+         }
+
+         if (features.sse2)
+         {
+            return &findLineStartsSSE2;
+         }
+#endif
+
+         return &findLineStartsScalar;
+      }
+
+      // Each returns the number of leading ASCII bytes
+      std::size_t countASCIIScalar(const uint8_t* data, std::size_t size)
+      {
+         static const uint64_t kHighBits = 0x8080808080808080;
+
+         std::size_t position = 0;
+         for (; position + sizeof(uint64_t) <= size; position += sizeof(uint64_t))
+         {
+            uint64_t word = 0;
+            std::memcpy(&word, data + position, sizeof(word));
+            if ((word & kHighBits) != 0)
+            {
+               break;
+            }
+         }
+
+         while (position < size && data[position] < 0x80)
+         {
+            ++position;
+         }
+
+         return position;
+      }
+
+      // Where the last sequence starting before the end begins if it's incomplete (otherwise the end), for data that's known to be valid up to there
+      std::size_t findSequenceBoundary(const uint8_t* data, std::size_t end)
+      {
+         if (end >= 1 && data[end - 1] >= 0xC0)
+         {
+            return end - 1;
+         }
+
+         if (end >= 2 && data[end - 2] >= 0xE0)
+         {
+            return end - 2;
+         }
+
+         if (end >= 3 && data[end - 3] >= 0xF0)
+         {
+            return end - 3;
+         }
+
+         return end;
+      }
+
+#if PLATFORM_UTILS_TEXT_X64
+      // Validation by lookup tables (Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte")
+      // Each byte is classified by the high nibble of the byte before it, that byte's low nibble, and its own high nibble, and the three classifications are ANDed together
+      // Anything left over is an error, apart from two continuation bytes in a row, which must be (and may only be) the end of a 3 or 4 byte sequence
+      constexpr uint8_t kTooShort = 1 << 0; // Lead byte followed by a lead or ASCII byte
+      constexpr uint8_t kTooLong = 1 << 1; // ASCII followed by a continuation byte
+      constexpr uint8_t kOverlong3 = 1 << 2;
+      constexpr uint8_t kTooLarge = 1 << 3;
+      constexpr uint8_t kSurrogate = 1 << 4;
+      constexpr uint8_t kOverlong2 = 1 << 5;
+      constexpr uint8_t kTooLarge1000 = 1 << 6;
+      constexpr uint8_t kOverlong4 = 1 << 6;
+      constexpr uint8_t kTwoContinuations = 1 << 7;
+      constexpr uint8_t kCarry = kTooShort | kTooLong | kTwoContinuations; // Errors that don't depend on the previous byte's low nibble
+
+      alignas(16) constexpr uint8_t kPreviousHighNibbleClasses[16] =
+      {
+         kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, // ASCII
+         kTwoContinuations, kTwoContinuations, kTwoContinuations, kTwoContinuations, // Continuation
+         kTooShort | kOverlong2, // 1100____
+         kTooShort, // 1101____
+         kTooShort | kOverlong3 | kSurrogate, // 1110____
+         kTooShort | kTooLarge | kTooLarge1000 | kOverlong4 // 1111____
+      };
+
+      alignas(16) constexpr uint8_t kPreviousLowNibbleClasses[16] =
+      {
+         kCarry | kOverlong3 | kOverlong2 | kOverlong4, // ____0000
+         kCarry | kOverlong2, // ____0001
+         kCarry,
+         kCarry,
+         kCarry | kTooLarge, // ____0100
+         kCarry | kTooLarge | kTooLarge1000,
+         kCarry | kTooLarge | kTooLarge1000,
+         kCarry | kTooLarge | kTooLarge1000,
+         kCarry | kTooLarge | kTooLarge1000,
+         kCarry | kTooLarge | kTooLarge1000,
+         kCarry | kTooLarge | kTooLarge1000,
+         kCarry | kTooLarge | kTooLarge1000,
+         kCarry | kTooLarge | kTooLarge1000,
+         kCarry | kTooLarge | kTooLarge1000 | kSurrogate, // ____1101
+         kCarry | kTooLarge | kTooLarge1000,
+         kCarry | kTooLarge | kTooLarge1000
+      };
+
+      alignas(16) constexpr uint8_t kHighNibbleClasses[16] =
+      {
+         kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, // ASCII
+         kTooLong | kOverlong2 | kTwoContinuations | kOverlong3 | kTooLarge1000 | kOverlong4, // 1000____
+         kTooLong | kOverlong2 | kTwoContinuations | kOverlong3 | kTooLarge, // 1001____
+         kTooLong | kOverlong2 | kTwoContinuations | kSurrogate | kTooLarge, // 101_____
+         kTooLong | kOverlong2 | kTwoContinuations | kSurrogate | kTooLarge,
+         kTooShort, kTooShort, kTooShort, kTooShort // Lead
+      };
+
+      // Non-zero where the last three bytes start a sequence that doesn't fit
+      alignas(16) constexpr uint8_t kIncompleteThresholds[16] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xEF, 0xDF, 0xBF };
+
+      PLATFORM_UTILS_TARGET_SSSE3 __m128i checkUTF8SSSE3(__m128i input, __m128i previousInput)
+      {
+         __m128i lowNibbleMask = _mm_set1_epi8(0x0F);
+         __m128i previous1 = _mm_alignr_epi8(input, previousInput, 15);
+         __m128i previous2 = _mm_alignr_epi8(input, previousInput, 14);
+         __m128i previous3 = _mm_alignr_epi8(input, previousInput, 13);
+
+         // There are no 8-bit shifts, so shift 16-bit lanes and mask off what came from the neighbouring byte
+         __m128i previousHigh = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(kPreviousHighNibbleClasses)), _mm_and_si128(_mm_srli_epi16(previous1, 4), lowNibbleMask));
+         __m128i previousLow = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(kPreviousLowNibbleClasses)), _mm_and_si128(previous1, lowNibbleMask));
+         __m128i high = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(kHighNibbleClasses)), _mm_and_si128(_mm_srli_epi16(input, 4), lowNibbleMask));
+         __m128i errors = _mm_and_si128(_mm_and_si128(previousHigh, previousLow), high);
+
+         // Saturating subtraction leaves the high bit set only for 3 / 4 byte leads two / three bytes back
+         __m128i isThirdByte = _mm_subs_epu8(previous2, _mm_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+         __m128i isFourthByte = _mm_subs_epu8(previous3, _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+         __m128i mustBeContinuation = _mm_and_si128(_mm_or_si128(isThirdByte, isFourthByte), _mm_set1_epi8(static_cast<char>(0x80)));
+
+         return _mm_xor_si128(errors, mustBeContinuation);
+      }
+
+      PLATFORM_UTILS_TARGET_SSSE3 bool validateUTF8BlocksSSSE3(const uint8_t* data, std::size_t size, std::size_t& numValidated)
+      {
+         static const std::size_t kVectorSize = 16;
+
+         __m128i incompleteThresholds = _mm_load_si128(reinterpret_cast<const __m128i*>(kIncompleteThresholds));
+         __m128i previousInput = _mm_setzero_si128();
+         __m128i previousIncomplete = _mm_setzero_si128();
+         __m128i errors = _mm_setzero_si128();
+
+         std::size_t position = 0;
+         for (; position + kVectorSize <= size; position += kVectorSize)
+         {
+            __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+            if (_mm_movemask_epi8(input) == 0)
+            {
+               // All ASCII, which is only valid if the previous block finished its last sequence
+               errors = _mm_or_si128(errors, previousIncomplete);
+               previousIncomplete = _mm_setzero_si128();
+            }
+            else
+            {
+               errors = _mm_or_si128(errors, checkUTF8SSSE3(input, previousInput));
+               previousIncomplete = _mm_subs_epu8(input, incompleteThresholds);
+            }
+
+            previousInput = input;
+         }
+
+         if (_mm_movemask_epi8(_mm_cmpeq_epi8(errors, _mm_setzero_si128())) != 0xFFFF)
+         {
+            return false;
+         }
+
+         numValidated = findSequenceBoundary(data, position);
+         return true;
+      }
+
+      PLATFORM_UTILS_TARGET_AVX2 __m256i checkUTF8AVX2(__m256i input, __m256i previousInput)
+      {
+         __m256i lowNibbleMask = _mm256_set1_epi8(0x0F);
+
+         // Bytes shifted in from the previous block, across the 128-bit lanes
+         __m256i shiftedIn = _mm256_permute2x128_si256(previousInput, input, 0x21);
+         __m256i previous1 = _mm256_alignr_epi8(input, shiftedIn, 15);
+         __m256i previous2 = _mm256_alignr_epi8(input, shiftedIn, 14);
+         __m256i previous3 = _mm256_alignr_epi8(input, shiftedIn, 13);
+
+         __m256i previousHigh = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kPreviousHighNibbleClasses))), _mm256_and_si256(_mm256_srli_epi16(previous1, 4), lowNibbleMask));
+         __m256i previousLow = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kPreviousLowNibbleClasses))), _mm256_and_si256(previous1, lowNibbleMask));
+         __m256i high = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kHighNibbleClasses))), _mm256_and_si256(_mm256_srli_epi16(input, 4), lowNibbleMask));
+         __m256i errors = _mm256_and_si256(_mm256_and_si256(previousHigh, previousLow), high);
+
+         __m256i isThirdByte = _mm256_subs_epu8(previous2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+         __m256i isFourthByte = _mm256_subs_epu8(previous3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+         __m256i mustBeContinuation = _mm256_and_si256(_mm256_or_si256(isThirdByte, isFourthByte), _mm256_set1_epi8(static_cast<char>(0x80)));
+
+         return _mm256_xor_si256(errors, mustBeContinuation);
+      }
+
+      PLATFORM_UTILS_TARGET_AVX2 bool validateUTF8BlocksAVX2(const uint8_t* data, std::size_t size, std::size_t& numValidated)
+      {
+         static const std::size_t kVectorSize = 32;
+
+         // Only the last three bytes of the upper lane matter
+         __m256i incompleteThresholds = _mm256_set_m128i(_mm_load_si128(reinterpret_cast<const __m128i*>(kIncompleteThresholds)), _mm_set1_epi8(static_cast<char>(0xFF)));
+         __m256i previousInput = _mm256_setzero_si256();
+         __m256i previousIncomplete = _mm256_setzero_si256();
+         __m256i errors = _mm256_setzero_si256();
+
+         std::size_t position = 0;
+         for (; position + kVectorSize <= size; position += kVectorSize)
+         {
+            __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + position));
+            if (_mm256_movemask_epi8(input) == 0)
+            {
+               errors = _mm256_or_si256(errors, previousIncomplete);
+               previousIncomplete = _mm256_setzero_si256();
+            }
+            else
+            {
+               errors = _mm256_or_si256(errors, checkUTF8AVX2(input, previousInput));
+               previousIncomplete = _mm256_subs_epu8(input, incompleteThresholds);
+            }
+
+            previousInput = input;
+         }
+
+         if (!_mm256_testz_si256(errors, errors))
+         {
+            return false;
+         }
+
+         numValidated = findSequenceBoundary(data, position);
+         return true;
+      }
+#endif
+
+      // Validates as many whole blocks as possible, starting at the beginning of a sequence, and reports how far it got (always to the beginning of a sequence)
+      using ValidateUTF8BlocksFunction = bool(*)(const uint8_t* data, std::size_t size, std::size_t& numValidated);
+
+      ValidateUTF8BlocksFunction selectValidateUTF8BlocksFunction()
+      {
+#if PLATFORM_UTILS_TEXT_X64
+         const OSUtils::CPUFeatures& features = OSUtils::getCPUFeatures();
+         if (features.avx2)
+         {
+            return &validateUTF8BlocksAVX2;
+         }
+
+         if (features.ssse3)
+         {
+            return &validateUTF8BlocksSSSE3;
+         }
+#endif
+
+         return nullptr;
+      }
+
+      void appendUTF8(uint32_t codePoint, std::string& output)
+      {
+         if (codePoint < 0x80)
+         {
+            output.push_back(static_cast<char>(codePoint));
+         }
+         else if (codePoint < 0x800)
+         {
+            output.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+            output.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+         }
+         else if (codePoint < 0x10000)
+         {
+            output.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+            output.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+            output.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+         }
+         else
+         {
+            output.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+            output.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+            output.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+            output.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+         }
+      }
+   }
+
+   std::vector<std::size_t> findLineStarts(std::string_view text, std::size_t numThreads)
+   {
+      static const FindLineStartsFunction kFindLineStarts = selectFindLineStartsFunction();
+
+      std::vector<std::size_t> lineStarts;
+      if (text.empty())
+      {
+         return lineStarts;
+      }
+
+      if (numThreads == 0)
+      {
+         numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+      }
+      numThreads = std::clamp<std::size_t>(text.size() / kMinBytesPerThread, 1, numThreads);
+
+      lineStarts.push_back(0);
+
+      if (numThreads == 1)
+      {
+         kFindLineStarts(text.data(), text.size(), 0, lineStarts);
+      }
+      else
+      {
+         // Each thread scans its own chunk, and the results are concatenated in order
+         std::vector<std::vector<std::size_t>> chunkLineStarts(numThreads);
+         std::vector<std::thread> threads;
+         threads.reserve(numThreads - 1);
+
+         std::size_t chunkSize = text.size() / numThreads;
+         auto scanChunk = [text, chunkSize, numThreads, &chunkLineStarts](std::size_t chunk)
+         {
+            std::size_t offset = chunk * chunkSize;
+            std::size_t size = chunk + 1 == numThreads ? text.size() - offset : chunkSize;
+            kFindLineStarts(text.data() + offset, size, offset, chunkLineStarts[chunk]);
+         };
+
+         for (std::size_t chunk = 1; chunk < numThreads; ++chunk)
+         {
+            threads.emplace_back(scanChunk, chunk);
+         }
+         scanChunk(0);
+
+         for (std::thread& thread : threads)
+         {
+            thread.join();
+         }
+
+         std::size_t numLineStarts = lineStarts.size();
+         for (const std::vector<std::size_t>& starts : chunkLineStarts)
+         {
+            numLineStarts += starts.size();
+         }
+
+         lineStarts.reserve(numLineStarts);
+         for (const std::vector<std::size_t>& starts : chunkLineStarts)
+         {
+            lineStarts.insert(lineStarts.end(), starts.begin(), starts.end());
+         }
+      }
+
+      // A newline at the very end terminates the last line, rather than starting a new one
+      if (lineStarts.back() == text.size())
+      {
+         lineStarts.pop_back();
+      }
+
+      return lineStarts;
+   }
+
+   std::string_view getLine(std::string_view text, std::size_t lineStart, std::size_t nextLineStart)
+   {
+      std::string_view line = text.substr(lineStart, std::min(nextLineStart, text.size()) - lineStart);
+
+      if (!line.empty() && line.back() == '\n')
+      {
+         line.remove_suffix(1);
+      }
+
+      if (!line.empty() && line.back() == '\r')
+      {
+         line.remove_suffix(1);
+      }
+
+      return line;
+   }
+
+   std::optional<ByteOrderMark> detectByteOrderMark(std::string_view text)
+   {
+      if (text.starts_with("\xEF\xBB\xBF"))
+      {
+         return ByteOrderMark{ TextEncoding::UTF8, 3 };
+      }
+
+      if (text.starts_with("\xFF\xFE"))
+      {
+         return ByteOrderMark{ TextEncoding::UTF16LE, 2 };
+      }
+
+      if (text.starts_with("\xFE\xFF"))
+      {
+         return ByteOrderMark{ TextEncoding::UTF16BE, 2 };
+      }
+
+      return std::nullopt;
+   }
+
+   bool UTF8Validator::update(std::string_view data)
+   {
+      static const ValidateUTF8BlocksFunction kValidateUTF8Blocks = selectValidateUTF8BlocksFunction();
+
+      const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+      std::size_t size = data.size();
+
+      // Finish a sequence that was split across calls
+      std::size_t position = std::min<std::size_t>(numContinuationBytes, size);
+      updateScalar(bytes, position);
+
+      if (valid && numContinuationBytes == 0 && kValidateUTF8Blocks)
+      {
+         std::size_t numValidated = 0;
+         valid = kValidateUTF8Blocks(bytes + position, size - position, numValidated);
+         position += numValidated;
+      }
+
+      // Less than a block is left (possibly ending partway through a sequence), unless there's no SIMD support
+      if (valid)
+      {
+         updateScalar(bytes + position, size - position);
+      }
+
+      return valid;
+   }
+
+   void UTF8Validator::updateScalar(const uint8_t* bytes, std::size_t size)
+   {
+      std::size_t position = 0;
+      while (valid && position < size)
+      {
+         if (numContinuationBytes == 0)
+         {
+            position += countASCIIScalar(bytes + position, size - position);
+            if (position == size)
+            {
+               break;
+            }
+
+            // Lead byte, which limits the range of the first continuation byte (see table 3-7 of the Unicode standard)
+            uint8_t byte = bytes[position++];
+            lowerBound = 0x80;
+            upperBound = 0xBF;
+
+            if (byte >= 0xC2 && byte <= 0xDF)
+            {
+               numContinuationBytes = 1;
+            }
+            else if (byte >= 0xE0 && byte <= 0xEF)
+            {
+               numContinuationBytes = 2;
+               if (byte == 0xE0)
+               {
+                  lowerBound = 0xA0; // Overlong
+               }
+               else if (byte == 0xED)
+               {
+                  upperBound = 0x9F; // Surrogates
+               }
+            }
+            else if (byte >= 0xF0 && byte <= 0xF4)
+            {
+               numContinuationBytes = 3;
+               if (byte == 0xF0)
+               {
+                  lowerBound = 0x90; // Overlong
+               }
+               else if (byte == 0xF4)
+               {
+                  upperBound = 0x8F; // Above U+10FFFF
+               }
+            }
+            else
+            {
+               valid = false;
+            }
+         }
+         else
+         {
+            uint8_t byte = bytes[position++];
+            if (byte < lowerBound || byte > upperBound)
+            {
+               valid = false;
+            }
+
+            --numContinuationBytes;
+            lowerBound = 0x80;
+            upperBound = 0xBF;
+         }
+      }
+   }
+
+   bool UTF8Validator::finish() const
+   {
+      return valid && numContinuationBytes == 0;
+   }
+
+   bool isValidUTF8(std::string_view text)
+   {
+      UTF8Validator validator;
+      return validator.update(text) && validator.finish();
+   }
+
+   std::optional<std::string> convertUTF16ToUTF8(std::string_view data, TextEncoding encoding)
+   {
+      if (data.size() % 2 != 0 || encoding == TextEncoding::UTF8)
+      {
+         return std::nullopt;
+      }
+
+      bool bigEndian = encoding == TextEncoding::UTF16BE;
+      auto readUnit = [&data, bigEndian](std::size_t index)
+      {
+         uint8_t first = static_cast<uint8_t>(data[index * 2]);
+         uint8_t second = static_cast<uint8_t>(data[index * 2 + 1]);
+         return static_cast<uint32_t>(bigEndian ? (first << 8) | second : (second << 8) | first);
+      };
+
+      std::size_t numUnits = data.size() / 2;
+      std::string output;
+      output.reserve(numUnits + numUnits / 2);
+
+      for (std::size_t index = 0; index < numUnits; ++index)
+      {
+         uint32_t unit = readUnit(index);
+         if (unit >= 0xD800 && unit <= 0xDBFF)
+         {
+            uint32_t nextUnit = index + 1 < numUnits ? readUnit(index + 1) : 0;
+            if (nextUnit < 0xDC00 || nextUnit > 0xDFFF)
+            {
+               return std::nullopt;
+            }
+
+            appendUTF8(0x10000 + ((unit - 0xD800) << 10) + (nextUnit - 0xDC00), output);
+            ++index;
+         }
+         else if (unit >= 0xDC00 && unit <= 0xDFFF)
+         {
+            return std::nullopt;
+         }
+         else
+         {
+            appendUTF8(unit, output);
+         }
+      }
+
+      return output;
+   }
+}
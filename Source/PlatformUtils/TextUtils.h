@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace TextUtils
+{
+   // Offsets of the first character of each line, found with an SSE2 / AVX2 newline scan where available
+   // A trailing newline doesn't start another (empty) line, so empty text has no lines
+   // Large inputs are split across numThreads threads (0 to use the hardware concurrency)
+   std::vector<std::size_t> findLineStarts(std::string_view text, std::size_t numThreads = 1);
+
+   // The line starting at the given offset, without its "\n" or "\r\n"
+   std::string_view getLine(std::string_view text, std::size_t lineStart, std::size_t nextLineStart);
+
+   enum class TextEncoding
+   {
+      UTF8,
+      UTF16LE,
+      UTF16BE
+   };
+
+   struct ByteOrderMark
+   {
+      TextEncoding encoding = TextEncoding::UTF8;
+      std::size_t size = 0;
+   };
+
+   std::optional<ByteOrderMark> detectByteOrderMark(std::string_view text);
+
+   // Validates UTF-8 incrementally, so that data can be checked as it arrives (sequences may be split across update() calls)
+   // Whole 16 / 32 byte blocks are checked with SSSE3 / AVX2 lookup tables where available, only what's left at the end of each update() goes through a byte at a time state machine
+   // Overlong encodings, surrogates and code points above U+10FFFF are rejected
+   class UTF8Validator
+   {
+   public:
+      // Returns false as soon as anything invalid has been seen
+      bool update(std::string_view data);
+
+      // Also checks that the data didn't end partway through a sequence
+      bool finish() const;
+
+   private:
+      void updateScalar(const uint8_t* bytes, std::size_t size);
+
+      uint8_t numContinuationBytes = 0;
+      uint8_t lowerBound = 0x80; // Valid range for the next continuation byte
+      uint8_t upperBound = 0xBF;
+      bool valid = true;
+   };
+
+   bool isValidUTF8(std::string_view text);
+
+   // Returns std::nullopt for unpaired surrogates, or an odd number of bytes
+   std::optional<std::string> convertUTF16ToUTF8(std::string_view data, TextEncoding encoding);
+}
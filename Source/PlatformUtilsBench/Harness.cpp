@@ -0,0 +1,255 @@
+#include "PlatformUtilsBench/Harness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <string_view>
+#include <utility>
+
+namespace Bench
+{
+   namespace
+   {
+      void printUsage(const char* programName)
+      {
+         std::fprintf(stderr, "Usage: %s [--warmup N] [--iterations N] [--filter TEXT] [--json PATH|-]\n", programName);
+      }
+
+      std::optional<int> parseCount(const char* text)
+      {
+         char* end = nullptr;
+         long value = std::strtol(text, &end, 10);
+         if (end == text || *end != '\0' || value < 0 || value > 1000000)
+         {
+            return std::nullopt;
+         }
+
+         return static_cast<int>(value);
+      }
+
+      // Nearest rank, on sorted samples
+      double getPercentile(const std::vector<double>& sortedSamples, double percentile)
+      {
+         std::size_t rank = static_cast<std::size_t>(std::ceil(percentile / 100.0 * sortedSamples.size()));
+         return sortedSamples[std::clamp<std::size_t>(rank, 1, sortedSamples.size()) - 1];
+      }
+
+      std::string escapeJSON(std::string_view text)
+      {
+         std::string escaped;
+         escaped.reserve(text.size());
+
+         for (char character : text)
+         {
+            switch (character)
+            {
+            case '"':
+               escaped += "\\\"";
+               break;
+            case '\\':
+               escaped += "\\\\";
+               break;
+            case '\n':
+               escaped += "\\n";
+               break;
+            default:
+               if (static_cast<unsigned char>(character) < 0x20)
+               {
+                  char buffer[8];
+                  std::snprintf(buffer, sizeof(buffer), "\\u%04x", character);
+                  escaped += buffer;
+               }
+               else
+               {
+                  escaped += character;
+               }
+               break;
+            }
+         }
+
+         return escaped;
+      }
+   }
+
+   std::optional<Options> parseOptions(int argc, char* argv[])
+   {
+      Options options;
+
+      for (int i = 1; i < argc; ++i)
+      {
+         std::string_view argument = argv[i];
+         const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+         if (!value)
+         {
+            printUsage(argv[0]);
+            return std::nullopt;
+         }
+
+         if (argument == "--warmup" || argument == "--iterations")
+         {
+            std::optional<int> count = parseCount(value);
+            if (!count || (argument == "--iterations" && *count == 0))
+            {
+               printUsage(argv[0]);
+               return std::nullopt;
+            }
+
+            (argument == "--warmup" ? options.numWarmupIterations : options.numIterations) = *count;
+         }
+         else if (argument == "--filter")
+         {
+            options.filter = value;
+         }
+         else if (argument == "--json")
+         {
+            options.jsonPath = value;
+         }
+         else
+         {
+            printUsage(argv[0]);
+            return std::nullopt;
+         }
+
+         ++i;
+      }
+
+      return options;
+   }
+
+   Summary summarize(std::vector<double> samples)
+   {
+      Summary summary;
+      summary.numSamples = samples.size();
+      if (samples.empty())
+      {
+         return summary;
+      }
+
+      std::sort(samples.begin(), samples.end());
+
+      summary.min = samples.front();
+      summary.max = samples.back();
+      summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+      summary.p50 = getPercentile(samples, 50.0);
+      summary.p90 = getPercentile(samples, 90.0);
+      summary.p99 = getPercentile(samples, 99.0);
+
+      return summary;
+   }
+
+   Harness::Harness(const Options& harnessOptions)
+      : options(harnessOptions)
+   {
+   }
+
+   void Harness::run(const std::string& name, uint64_t bytesPerIteration, const std::function<void()>& function, int iterationScale)
+   {
+      std::optional<Result> result = measure(name, [&function]() -> std::optional<double>
+      {
+         auto start = std::chrono::steady_clock::now();
+         function();
+         auto end = std::chrono::steady_clock::now();
+
+         return std::chrono::duration<double>(end - start).count();
+      }, iterationScale);
+
+      if (result)
+      {
+         result->bytesPerIteration = bytesPerIteration;
+         report(std::move(*result));
+      }
+   }
+
+   void Harness::runSampled(const std::string& name, const std::function<std::optional<double>()>& sampleFunction, int iterationScale)
+   {
+      if (std::optional<Result> result = measure(name, sampleFunction, iterationScale))
+      {
+         report(std::move(*result));
+      }
+   }
+
+   void Harness::writeJSON(std::ostream& stream) const
+   {
+      auto toMilliseconds = [](double seconds) { return seconds * 1000.0; };
+
+      stream << "{\n  \"benchmarks\": [";
+      for (std::size_t i = 0; i < results.size(); ++i)
+      {
+         const Result& result = results[i];
+         const Summary& summary = result.summary;
+
+         char buffer[512];
+         std::snprintf(buffer, sizeof(buffer),
+            "\"samples\": %zu, \"failed_samples\": %zu, \"bytes_per_iteration\": %llu, "
+            "\"min_ms\": %.6f, \"mean_ms\": %.6f, \"p50_ms\": %.6f, \"p90_ms\": %.6f, \"p99_ms\": %.6f, \"max_ms\": %.6f",
+            summary.numSamples, result.numFailedSamples, static_cast<unsigned long long>(result.bytesPerIteration),
+            toMilliseconds(summary.min), toMilliseconds(summary.mean), toMilliseconds(summary.p50), toMilliseconds(summary.p90), toMilliseconds(summary.p99), toMilliseconds(summary.max));
+
+         stream << (i == 0 ? "\n" : ",\n") << "    { \"name\": \"" << escapeJSON(result.name) << "\", " << buffer;
+         if (result.bytesPerIteration > 0 && summary.p50 > 0.0)
+         {
+            std::snprintf(buffer, sizeof(buffer), ", \"p50_mb_per_s\": %.3f", result.bytesPerIteration / summary.p50 / (1024.0 * 1024.0));
+            stream << buffer;
+         }
+         stream << " }";
+      }
+      stream << "\n  ]\n}\n";
+   }
+
+   std::optional<Harness::Result> Harness::measure(const std::string& name, const std::function<std::optional<double>()>& sampleFunction, int iterationScale) const
+   {
+      if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+      {
+         return std::nullopt;
+      }
+
+      for (int i = 0; i < options.numWarmupIterations; ++i)
+      {
+         sampleFunction();
+      }
+
+      Result result;
+      result.name = name;
+
+      std::vector<double> samples;
+      int numIterations = options.numIterations * std::max(iterationScale, 1);
+      samples.reserve(numIterations);
+      for (int i = 0; i < numIterations; ++i)
+      {
+         if (std::optional<double> sample = sampleFunction())
+         {
+            samples.push_back(*sample);
+         }
+         else
+         {
+            ++result.numFailedSamples;
+         }
+      }
+
+      result.summary = summarize(std::move(samples));
+      return result;
+   }
+
+   void Harness::report(Result result)
+   {
+      const Summary& summary = result.summary;
+      std::FILE* output = options.jsonPath && *options.jsonPath == "-" ? stderr : stdout; // Keep stdout clean for the JSON
+
+      std::fprintf(output, "%-36s p50 %10.3f ms   p90 %10.3f ms   p99 %10.3f ms", result.name.c_str(), summary.p50 * 1000.0, summary.p90 * 1000.0, summary.p99 * 1000.0);
+      if (result.bytesPerIteration > 0 && summary.p50 > 0.0)
+      {
+         std::fprintf(output, "   %10.1f MB/s", result.bytesPerIteration / summary.p50 / (1024.0 * 1024.0));
+      }
+      if (result.numFailedSamples > 0)
+      {
+         std::fprintf(output, "   (%zu failed)", result.numFailedSamples);
+      }
+      std::fprintf(output, "\n");
+      std::fflush(output); // Show progress as it's made, and don't leave anything buffered for forked children to flush again
+
+      results.push_back(std::move(result));
+   }
+}
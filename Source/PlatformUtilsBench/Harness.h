@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Bench
+{
+   struct Options
+   {
+      int numWarmupIterations = 1;
+      int numIterations = 20;
+      std::string filter; // Only benchmarks whose names contain this are run
+      std::optional<std::filesystem::path> jsonPath; // "-" for stdout
+   };
+
+   // Parses --warmup N, --iterations N, --filter TEXT and --json PATH, returning std::nullopt (after printing usage) for anything else
+   std::optional<Options> parseOptions(int argc, char* argv[]);
+
+   struct Summary
+   {
+      std::size_t numSamples = 0;
+      double min = 0.0; // All in seconds
+      double mean = 0.0;
+      double p50 = 0.0;
+      double p90 = 0.0;
+      double p99 = 0.0;
+      double max = 0.0;
+   };
+
+   Summary summarize(std::vector<double> samples);
+
+   class Harness
+   {
+   public:
+      explicit Harness(const Options& harnessOptions);
+
+      // Times each call of the function (bytesPerIteration is only used to report throughput, 0 if it doesn't apply)
+      void run(const std::string& name, uint64_t bytesPerIteration, const std::function<void()>& function, int iterationScale = 1);
+
+      // For latencies that can't be timed from the outside, the function measures a single sample itself and returns it (in seconds, std::nullopt if it timed out)
+      void runSampled(const std::string& name, const std::function<std::optional<double>()>& sampleFunction, int iterationScale = 1);
+
+      void writeJSON(std::ostream& stream) const;
+
+      const Options& getOptions() const
+      {
+         return options;
+      }
+
+   private:
+      struct Result
+      {
+         std::string name;
+         uint64_t bytesPerIteration = 0;
+         std::size_t numFailedSamples = 0;
+         Summary summary;
+      };
+
+      std::optional<Result> measure(const std::string& name, const std::function<std::optional<double>()>& sampleFunction, int iterationScale) const;
+      void report(Result result);
+
+      Options options;
+      std::vector<Result> results;
+   };
+}
@@ -0,0 +1,355 @@
+#include "PlatformUtils/ExecutableResolver.h"
+#include "PlatformUtils/IOUtils.h"
+#include "PlatformUtils/OSUtils.h"
+#include "PlatformUtils/ProcessPool.h"
+
+#include "PlatformUtilsBench/Harness.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+   // The original iostream-based implementations, kept as a baseline
+   namespace Legacy
+   {
+      std::optional<std::string> readTextFile(const std::filesystem::path& path)
+      {
+         if (std::filesystem::is_regular_file(path))
+         {
+            std::ifstream in(path);
+            if (in)
+            {
+               return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            }
+         }
+
+         return std::nullopt;
+      }
+
+      std::optional<std::vector<uint8_t>> readBinaryFile(const std::filesystem::path& path)
+      {
+         if (std::filesystem::is_regular_file(path))
+         {
+            std::ifstream in(path, std::ifstream::binary);
+            if (in)
+            {
+               std::streampos start = in.tellg();
+               in.seekg(0, std::ios_base::end);
+               std::streamoff size = in.tellg() - start;
+
+               if (size > 0)
+               {
+                  in.seekg(0, std::ios_base::beg);
+
+                  std::vector<uint8_t> data(static_cast<size_t>(size));
+                  in.read(reinterpret_cast<char*>(data.data()), size);
+
+                  return data;
+               }
+            }
+         }
+
+         return std::nullopt;
+      }
+
+      bool writeBinaryFile(const std::filesystem::path& path, const std::vector<uint8_t>& data)
+      {
+         std::ofstream out(path, std::ofstream::binary);
+         if (out)
+         {
+            out.write(reinterpret_cast<const char*>(data.data()), data.size());
+            return true;
+         }
+
+         return false;
+      }
+   }
+
+   void benchmarkFiles(Bench::Harness& harness, const std::filesystem::path& directory)
+   {
+      static const int kNumSmallFiles = 1000;
+      static const std::size_t kSmallFileSize = 4 * 1024;
+      static const std::size_t kLargeFileSize = 64 * 1024 * 1024;
+      static const uint64_t kSmallFilesBytes = kNumSmallFiles * kSmallFileSize;
+
+      std::vector<uint8_t> smallData(kSmallFileSize, 'a');
+      std::vector<std::filesystem::path> smallPaths;
+      for (int i = 0; i < kNumSmallFiles; ++i)
+      {
+         smallPaths.push_back(directory / ("small" + std::to_string(i) + ".txt"));
+         IOUtils::writeBinaryFile(smallPaths.back(), smallData);
+      }
+
+      std::filesystem::path largePath = directory / "large.bin";
+      std::vector<uint8_t> largeData(kLargeFileSize, 'b');
+      IOUtils::writeBinaryFile(largePath, largeData);
+
+      harness.run("read/small/text/iostream", kSmallFilesBytes, [&]() { for (const std::filesystem::path& path : smallPaths) { Legacy::readTextFile(path); } });
+      harness.run("read/small/text", kSmallFilesBytes, [&]() { for (const std::filesystem::path& path : smallPaths) { IOUtils::readTextFile(path); } });
+      harness.run("read/small/binary/iostream", kSmallFilesBytes, [&]() { for (const std::filesystem::path& path : smallPaths) { Legacy::readBinaryFile(path); } });
+      harness.run("read/small/binary", kSmallFilesBytes, [&]() { for (const std::filesystem::path& path : smallPaths) { IOUtils::readBinaryFile(path); } });
+      harness.run("read/small/binary/batch", kSmallFilesBytes, [&]() { IOUtils::readFilesBatch(smallPaths); });
+      harness.run("read/large/text/iostream", kLargeFileSize, [&]() { Legacy::readTextFile(largePath); });
+      harness.run("read/large/text", kLargeFileSize, [&]() { IOUtils::readTextFile(largePath); });
+      harness.run("read/large/binary/iostream", kLargeFileSize, [&]() { Legacy::readBinaryFile(largePath); });
+      harness.run("read/large/binary", kLargeFileSize, [&]() { IOUtils::readBinaryFile(largePath); });
+      harness.run("read/large/mapped", kLargeFileSize, [&]()
+      {
+         if (std::optional<OSUtils::MappedFile> mappedFile = IOUtils::mapBinaryFile(largePath))
+         {
+            // Touch every page, so the mapping is actually read
+            volatile uint8_t sum = 0;
+            std::span<const uint8_t> data = mappedFile->getData();
+            for (std::size_t i = 0; i < data.size(); i += 4096)
+            {
+               sum = sum + data[i];
+            }
+         }
+      });
+
+      harness.run("write/small/binary/iostream", kSmallFilesBytes, [&]() { for (const std::filesystem::path& path : smallPaths) { Legacy::writeBinaryFile(path, smallData); } });
+      harness.run("write/small/binary", kSmallFilesBytes, [&]() { for (const std::filesystem::path& path : smallPaths) { IOUtils::writeBinaryFile(path, smallData); } });
+      harness.run("write/large/binary/iostream", kLargeFileSize, [&]() { Legacy::writeBinaryFile(largePath, largeData); });
+      harness.run("write/large/binary", kLargeFileSize, [&]() { IOUtils::writeBinaryFile(largePath, largeData); });
+   }
+
+   void benchmarkProcesses(Bench::Harness& harness, OSUtils::ForkServer& forkServer)
+   {
+      // Something that exists on any machine, and exits immediately
+      OSUtils::ProcessStartInfo startInfo;
+#if defined(_WIN32)
+      startInfo.path = "C:\\Windows\\System32\\cmd.exe";
+      startInfo.args = { "/c", "exit" };
+#else
+      startInfo.path = "/bin/true";
+#endif
+
+      static const std::size_t kBallastSize = 1024 * 1024 * 1024;
+
+      auto runLaunchBenchmarks = [&harness, &forkServer, &startInfo](const std::string& suffix)
+      {
+         // The server stays small however large we get
+         if (forkServer.isRunning())
+         {
+            harness.run("process/fork-server" + suffix, 0, [&]() { forkServer.executeProcess(startInfo); }, 5);
+         }
+
+         for (OSUtils::ProcessLaunchMethod launchMethod : { OSUtils::ProcessLaunchMethod::Spawn, OSUtils::ProcessLaunchMethod::Fork })
+         {
+            std::string name = launchMethod == OSUtils::ProcessLaunchMethod::Spawn ? "process/spawn" : "process/fork";
+
+            OSUtils::ProcessStartInfo launchStartInfo = startInfo;
+            launchStartInfo.launchMethod = launchMethod;
+            harness.run(name + suffix, 0, [&]() { OSUtils::executeProcess(launchStartInfo); }, 5);
+
+            launchStartInfo.readOutput = true;
+            harness.run(name + "/output" + suffix, 0, [&]() { OSUtils::executeProcess(launchStartInfo); }, 5);
+         }
+      };
+
+      runLaunchBenchmarks("");
+
+      // Building the environment is otherwise repeated for every launch
+      harness.run("process/environment/build", 0, []() { OSUtils::EnvironmentBlock environment; }, 5);
+
+      OSUtils::ProcessStartInfo environmentStartInfo = startInfo;
+      environmentStartInfo.environment = OSUtils::EnvironmentBlock();
+      harness.run("process/spawn/prebuilt-environment", 0, [&]() { OSUtils::executeProcess(environmentStartInfo); }, 5);
+
+      // Bare names are looked up on PATH, from cached directory listings
+      OSUtils::ProcessStartInfo bareNameStartInfo = startInfo;
+      bareNameStartInfo.path = startInfo.path.filename();
+      harness.run("process/resolve", 0, [&]() { OSUtils::getExecutableResolver().resolve(bareNameStartInfo.path); }, 5);
+      harness.run("process/spawn/bare-name", 0, [&]() { OSUtils::executeProcess(bareNameStartInfo); }, 5);
+
+      // Many processes in flight at once, all waited for on this thread
+      static const int kNumConcurrentProcesses = 64;
+      harness.run("process/reactor/64", 0, [&]()
+      {
+         OSUtils::ProcessReactor reactor;
+         for (int i = 0; i < kNumConcurrentProcesses; ++i)
+         {
+            if (std::optional<OSUtils::ProcessHandle> process = OSUtils::startProcess(startInfo))
+            {
+               reactor.add(std::move(*process), nullptr);
+            }
+         }
+
+         while (reactor.getNumProcesses() > 0)
+         {
+            reactor.wait();
+         }
+      });
+
+      OSUtils::ProcessStartInfo outputStartInfo = startInfo;
+      outputStartInfo.readOutput = true;
+      harness.run("process/pool/64", 0, [&]()
+      {
+         OSUtils::ProcessPool pool;
+         for (int i = 0; i < kNumConcurrentProcesses; ++i)
+         {
+            pool.submit(outputStartInfo);
+         }
+
+         while (pool.waitForResult())
+         {
+         }
+      });
+
+#if !defined(_WIN32)
+      // Input and output pumped at the same time, through one process and then through a pipeline (where only the ends pass through us)
+      // The input comes from a function so that copying the start info doesn't copy the data too
+      static const std::size_t kStdInSize = 64 * 1024 * 1024;
+      std::string stdInData(kStdInSize, 'x');
+      OSUtils::ProcessStartInfo catStartInfo;
+      catStartInfo.path = "/bin/cat";
+
+      auto runWithInput = [&catStartInfo, &stdInData](std::size_t numStages)
+      {
+         std::string_view remaining = stdInData;
+         std::vector<OSUtils::ProcessStartInfo> startInfos(numStages, catStartInfo);
+         startInfos.front().stdInFunction = [&remaining](std::span<char> buffer)
+         {
+            std::size_t size = std::min(buffer.size(), remaining.size());
+            std::copy_n(remaining.data(), size, buffer.data());
+            remaining.remove_prefix(size);
+            return size;
+         };
+         startInfos.back().readOutput = true;
+
+         OSUtils::executePipeline(std::move(startInfos));
+      };
+
+      harness.run("process/stdin/cat", kStdInSize, [&]() { runWithInput(1); });
+      harness.run("process/pipeline/cat-3", kStdInSize, [&]() { runWithInput(3); });
+#endif
+
+      // Forking has to copy the page tables of everything that's resident, spawning shouldn't be affected
+      std::vector<uint8_t> ballast(kBallastSize, 1);
+      runLaunchBenchmarks("/1GB-resident");
+   }
+
+   void benchmarkDirectoryWatcher(Bench::Harness& harness, const std::filesystem::path& directory)
+   {
+      static const int kNumChurnFiles = 64;
+      static const auto kTimeout = std::chrono::seconds(2);
+
+      std::filesystem::path watchDirectory = directory / "watch";
+      std::filesystem::create_directories(watchDirectory);
+
+      OSUtils::DirectoryWatcher watcher;
+
+      std::string expectedFile;
+      std::optional<std::chrono::steady_clock::time_point> arrivalTime;
+      watcher.addWatch(watchDirectory, false, [&](OSUtils::DirectoryWatchEvent event, const std::filesystem::path& /* directory */, const std::filesystem::path& file)
+      {
+         if (!arrivalTime && event == OSUtils::DirectoryWatchEvent::Create && file == expectedFile)
+         {
+            arrivalTime = std::chrono::steady_clock::now();
+         }
+      });
+
+      // Constantly modify, create and delete other files, so the marker's notification has to make it through a stream of unrelated ones
+      std::atomic<bool> stopChurning = { false };
+      std::thread churnThread([&]()
+      {
+         std::vector<uint8_t> data(256, 'c');
+         for (uint64_t i = 0; !stopChurning; ++i)
+         {
+            std::filesystem::path churnPath = watchDirectory / ("churn" + std::to_string(i % kNumChurnFiles));
+            if (i % 3 == 0)
+            {
+               std::error_code errorCode;
+               std::filesystem::remove(churnPath, errorCode);
+            }
+            else
+            {
+               IOUtils::writeBinaryFile(churnPath, data);
+            }
+         }
+      });
+
+      int markerIndex = 0;
+      harness.runSampled("watcher/latency/churn", [&]() -> std::optional<double>
+      {
+         expectedFile = "marker" + std::to_string(markerIndex++);
+         arrivalTime.reset();
+
+         std::filesystem::path markerPath = watchDirectory / expectedFile;
+         auto start = std::chrono::steady_clock::now();
+         IOUtils::writeBinaryFile(markerPath, std::vector<uint8_t>{});
+
+         while (!arrivalTime && std::chrono::steady_clock::now() - start < kTimeout)
+         {
+            watcher.update();
+         }
+
+         std::error_code errorCode;
+         std::filesystem::remove(markerPath, errorCode);
+
+         if (!arrivalTime)
+         {
+            return std::nullopt;
+         }
+
+         return std::chrono::duration<double>(*arrivalTime - start).count();
+      }, 5);
+
+      stopChurning = true;
+      churnThread.join();
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   // Started before anything else, while we're still small
+   OSUtils::ForkServer forkServer;
+
+   std::optional<Bench::Options> options = Bench::parseOptions(argc, argv);
+   if (!options)
+   {
+      return 1;
+   }
+
+   std::filesystem::path directory = std::filesystem::temp_directory_path() / "PlatformUtilsBench";
+   std::filesystem::create_directories(directory);
+
+   Bench::Harness harness(*options);
+   benchmarkFiles(harness, directory);
+   benchmarkProcesses(harness, forkServer);
+   benchmarkDirectoryWatcher(harness, directory);
+
+   std::error_code errorCode;
+   std::filesystem::remove_all(directory, errorCode);
+
+   if (options->jsonPath)
+   {
+      if (*options->jsonPath == "-")
+      {
+         harness.writeJSON(std::cout);
+      }
+      else
+      {
+         std::ofstream out(*options->jsonPath);
+         harness.writeJSON(out);
+         if (!out)
+         {
+            std::fprintf(stderr, "Failed to write %s\n", options->jsonPath->string().c_str());
+            return 1;
+         }
+      }
+   }
+
+   return 0;
+}
@@ -0,0 +1,276 @@
+#include "PlatformUtils/AppendLog.h"
+#include "PlatformUtils/HashUtils.h"
+#include "PlatformUtils/IOUtils.h"
+#include "PlatformUtils/OSUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace
+{
+   bool check(bool condition, std::string_view description, int line)
+   {
+      if (!condition)
+      {
+         std::fprintf(stderr, "Line %d: %.*s failed\n", line, static_cast<int>(description.size()), description.data());
+      }
+
+      return condition;
+   }
+
+#define CHECK(condition) if (!check(condition, #condition, __LINE__)) { return false; }
+
+   std::filesystem::path getTestDirectory()
+   {
+      std::filesystem::path directory = std::filesystem::temp_directory_path() / "PlatformUtilsTests";
+
+      std::error_code errorCode;
+      std::filesystem::remove_all(directory, errorCode);
+      std::filesystem::create_directories(directory, errorCode);
+
+      return directory;
+   }
+
+   bool testAppendLogUnwritablePath()
+   {
+      // A regular file can't have children, so the log can't be created (even with privileges)
+      std::filesystem::path blockingFile = getTestDirectory() / "NotADirectory";
+      CHECK(IOUtils::writeTextFile(blockingFile, "x"));
+
+      IOUtils::AppendLog log(blockingFile / "Log.txt");
+      CHECK(!log.isOpen());
+
+      uint64_t sequence = log.append("record");
+      CHECK(sequence == IOUtils::AppendLog::kInvalidSequence);
+      CHECK(!log.waitUntilDurable(sequence));
+      CHECK(!log.flush());
+      CHECK(!log.close());
+
+      return true;
+   }
+
+   bool testAppendLogAppendAfterClose()
+   {
+      std::filesystem::path path = getTestDirectory() / "Log.txt";
+
+      IOUtils::AppendLog log(path);
+      CHECK(log.isOpen());
+
+      uint64_t sequence = log.append("first\n");
+      CHECK(log.waitUntilDurable(sequence));
+      CHECK(log.close());
+
+      uint64_t droppedSequence = log.append("second\n");
+      CHECK(droppedSequence == IOUtils::AppendLog::kInvalidSequence);
+      CHECK(!log.waitUntilDurable(droppedSequence));
+      CHECK(log.flush());
+
+      std::optional<std::string> contents = IOUtils::readTextFile(path);
+      CHECK(contents && *contents == "first\n");
+
+      return true;
+   }
+
+   bool testHashEmptyInput()
+   {
+      HashUtils::Hasher hasher;
+      hasher.update({});
+      CHECK(hasher.finish() == HashUtils::Hasher().finish());
+      CHECK(HashUtils::hash(std::span<const uint8_t>{}) == HashUtils::hash(std::string_view{}));
+
+      // Empty updates in between don't change anything either
+      static const uint8_t kData[] = { 1, 2, 3 };
+      HashUtils::Hasher splitHasher;
+      splitHasher.update(std::span<const uint8_t>(kData).first(1));
+      splitHasher.update({});
+      splitHasher.update(std::span<const uint8_t>(kData).subspan(1));
+      CHECK(splitHasher.finish() == HashUtils::hash(kData));
+
+      return true;
+   }
+
+   bool testHashInstructionSetsAndSplits()
+   {
+      // Covers partial stripes, partial blocks and several whole blocks (a block is 256 bytes)
+      std::vector<uint8_t> data(1100);
+      uint32_t state = 12345;
+      for (uint8_t& byte : data)
+      {
+         state = state * 1664525 + 1013904223;
+         byte = static_cast<uint8_t>(state >> 24);
+      }
+
+      static const HashUtils::HashInstructionSet kInstructionSets[] = { HashUtils::HashInstructionSet::Scalar, HashUtils::HashInstructionSet::SSE2, HashUtils::HashInstructionSet::AVX2 };
+      static const std::size_t kChunkSizes[] = { 1, 7, 31, 32, 33, 255, 256, 257, 1000 };
+
+      for (std::size_t size = 0; size <= data.size(); size += (size < 600 ? 1 : 37))
+      {
+         std::span<const uint8_t> input = std::span<const uint8_t>(data).first(size);
+         HashUtils::Hash128 expected = HashUtils::hash(input);
+
+         for (HashUtils::HashInstructionSet instructionSet : kInstructionSets)
+         {
+            HashUtils::Hasher wholeHasher(instructionSet);
+            wholeHasher.update(input);
+            CHECK(wholeHasher.finish() == expected);
+
+            for (std::size_t chunkSize : kChunkSizes)
+            {
+               HashUtils::Hasher chunkHasher(instructionSet);
+               for (std::size_t offset = 0; offset < size; offset += chunkSize)
+               {
+                  chunkHasher.update(input.subspan(offset, std::min(chunkSize, size - offset)));
+               }
+               CHECK(chunkHasher.finish() == expected);
+            }
+         }
+      }
+
+      return true;
+   }
+
+#if !defined(_WIN32)
+   bool testWriteThroughSymlink()
+   {
+      std::filesystem::path directory = getTestDirectory();
+      std::filesystem::path target = directory / "Target.txt";
+      std::filesystem::path link = directory / "Link.txt";
+
+      CHECK(IOUtils::writeTextFile(target, "old"));
+      std::filesystem::create_symlink("Target.txt", link);
+
+      for (IOUtils::WriteMode mode : { IOUtils::WriteMode::Plain, IOUtils::WriteMode::Atomic, IOUtils::WriteMode::Durable })
+      {
+         std::string contents = "mode " + std::to_string(static_cast<int>(mode));
+         CHECK(IOUtils::writeTextFile(link, contents, IOUtils::WriteOptions{ mode }));
+
+         CHECK(std::filesystem::is_symlink(link));
+         CHECK(IOUtils::readTextFile(target) == contents);
+      }
+
+      // Links to files that don't exist yet create them, like plain writes do
+      std::filesystem::path danglingLink = directory / "Dangling.txt";
+      std::filesystem::create_symlink("Created.txt", danglingLink);
+      CHECK(IOUtils::writeTextFile(danglingLink, "created", IOUtils::WriteOptions{ IOUtils::WriteMode::Atomic }));
+      CHECK(std::filesystem::is_symlink(danglingLink));
+      CHECK(IOUtils::readTextFile(directory / "Created.txt") == "created");
+
+      return true;
+   }
+
+   bool testProcessArgumentZero()
+   {
+      // Short enough for the path to be stored inline, which is where a moved argv[0] used to be left dangling
+      for (OSUtils::ProcessLaunchMethod launchMethod : { OSUtils::ProcessLaunchMethod::Spawn, OSUtils::ProcessLaunchMethod::Fork })
+      {
+         OSUtils::ProcessStartInfo startInfo;
+         startInfo.path = "/bin/sh";
+         startInfo.args = { "-c", "echo $0" };
+         startInfo.readOutput = true;
+         startInfo.launchMethod = launchMethod;
+
+         std::optional<OSUtils::ProcessExitInfo> exitInfo = OSUtils::executeProcess(std::move(startInfo));
+         CHECK(exitInfo && exitInfo->exitCode == 0);
+         CHECK(exitInfo->stdOut == "/bin/sh\n");
+      }
+
+      return true;
+   }
+
+   bool testProcessExecFailure()
+   {
+      // Fork reports it like Spawn does, rather than as a child that exited with some code
+      for (OSUtils::ProcessLaunchMethod launchMethod : { OSUtils::ProcessLaunchMethod::Spawn, OSUtils::ProcessLaunchMethod::Fork })
+      {
+         for (const char* path : { "/nonexistent/PlatformUtilsTests", "PlatformUtilsTestsNotOnPath" })
+         {
+            OSUtils::ProcessStartInfo startInfo;
+            startInfo.path = path;
+            startInfo.launchMethod = launchMethod;
+
+            CHECK(!OSUtils::executeProcess(startInfo));
+            CHECK(!OSUtils::startProcess(std::move(startInfo)));
+         }
+      }
+
+      return true;
+   }
+
+   bool testProcessHandleSignaled()
+   {
+      OSUtils::ProcessStartInfo startInfo;
+      startInfo.path = "/bin/sh";
+      startInfo.args = { "-c", "kill -KILL $$" };
+
+      std::optional<OSUtils::ProcessHandle> process = OSUtils::startProcess(std::move(startInfo));
+      CHECK(process.has_value());
+      CHECK(process->wait());
+      CHECK(process->getExitCode() == 128 + SIGKILL);
+
+      const std::optional<OSUtils::ProcessExitInfo>& exitInfo = process->getExitInfo();
+      CHECK(exitInfo && exitInfo->terminationSignal == SIGKILL);
+      CHECK(exitInfo->wallTime.count() > 0 && exitInfo->peakResidentSize > 0);
+
+      return true;
+   }
+
+   bool testProcessReactorExitInfo()
+   {
+      OSUtils::ProcessStartInfo startInfo;
+      startInfo.path = "/bin/sh";
+      startInfo.args = { "-c", "exit 3" };
+
+      std::optional<OSUtils::ProcessHandle> process = OSUtils::startProcess(std::move(startInfo));
+      CHECK(process.has_value());
+
+      std::optional<OSUtils::ProcessExitInfo> exitInfo;
+      OSUtils::ProcessReactor reactor;
+      reactor.add(std::move(*process), [&exitInfo](OSUtils::ProcessHandle& exitedProcess) { exitInfo = exitedProcess.getExitInfo(); });
+      CHECK(reactor.wait(std::chrono::seconds(10)) == 1);
+      CHECK(exitInfo && exitInfo->exitCode == 3 && !exitInfo->terminationSignal);
+      CHECK(exitInfo->peakResidentSize > 0);
+
+      return true;
+   }
+#endif
+}
+
+int main()
+{
+   static const std::pair<const char*, std::function<bool()>> kTests[] =
+   {
+      { "AppendLog/UnwritablePath", testAppendLogUnwritablePath },
+      { "AppendLog/AppendAfterClose", testAppendLogAppendAfterClose },
+      { "HashUtils/EmptyInput", testHashEmptyInput },
+      { "HashUtils/InstructionSetsAndSplits", testHashInstructionSetsAndSplits },
+#if !defined(_WIN32)
+      { "IOUtils/WriteThroughSymlink", testWriteThroughSymlink },
+      { "Process/ArgumentZero", testProcessArgumentZero },
+      { "Process/ExecFailure", testProcessExecFailure },
+      { "ProcessHandle/Signaled", testProcessHandleSignaled },
+      { "ProcessReactor/ExitInfo", testProcessReactorExitInfo }
+#endif
+   };
+
+   int numFailed = 0;
+   for (const auto& [name, test] : kTests)
+   {
+      bool passed = test();
+      std::printf("%s %s\n", passed ? "PASS" : "FAIL", name);
+
+      numFailed += passed ? 0 : 1;
+   }
+
+   return numFailed == 0 ? 0 : 1;
+}